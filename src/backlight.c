@@ -1,16 +1,6 @@
 #include <pebble.h>
-
-#define START_HOUR	0
-#define START_MINUTE	1
-#define STOP_HOUR	2
-#define STOP_MINUTE	3
-#define START_ALARM	4
-#define STOP_ALARM	5
-#define DURATION	6
-#define SAMPLES		7
-#define CHARGING	8
-#define PLUGGED		9
-#define AMBIENT		10
+#include "log.h"
+#include "config.h"
 
 /* Screen size info */
 #if defined(PBL_RECT)
@@ -52,16 +42,25 @@ int time_setting;
 #define TIME_START	0
 #define TIME_STOP	1
 char *which[2]={"start", "stop"};
-int start_hour;
-int start_min;
-int stop_hour;
-int stop_min;
+Schedule schedule;
+SchedTable sched_table;
+int sched_profile;                      /* window being edited */
+int sched_window;
 int time_duration;
+int dwell=5;                            /* raise delay, in 1/10th seconds */
 WakeupId start_alarm_id;
 WakeupId stop_alarm_id;
 bool charging_mode=false;               /* on while charging mode */
 bool plugged_mode=false;                /* on while plugged in mode */
 bool ambient=false;                     /* recognize ambient light */
+bool trace_mode=false;                  /* worker records accel traces */
+bool tap_wake=false;                    /* worker samples only after a tap */
+bool battery_saver=true;                /* worker backs off as the battery runs down */
+bool usage_log=false;                   /* worker logs light use for the phone */
+uint8_t wrist_profile=PROFILE_BOX;      /* how the watch is worn */
+bool raw_accel=false;                   /* worker takes lean raw samples */
+uint8_t detector_kind=DETECTOR_POSTURE; /* what lights the light */
+time_t awake_until=0;                   /* turned on by hand: see launch_worker() */
 
 Window *sample_window=NULL;
 TextLayer *sample_layer=NULL;
@@ -69,20 +68,94 @@ uint samples=1;
 #define SAMPLE_TEXT "Response of backlight in 1/10th second increments:"
 char sample_text[sizeof(SAMPLE_TEXT) + 10];
 
+/*
+ * Settings writes are coalesced: save_settings() only notes the record
+ * as changed, and flush_settings() writes it, once, when the user gets
+ * back to the main window or leaves the app.  A record the same as the
+ * one in flash is never written again.
+ */
+Settings settings_saved;                /* as last read or written */
+Settings settings_pending;
+bool settings_dirty=false;
+
+void
+save_settings (void) 
+{
+    Settings s;
+
+    memset(&s, 0, sizeof(s));
+    s.version = SETTINGS_VERSION;
+    s.duration = (uint8_t)time_duration;
+    s.samples = (uint8_t)samples;
+    s.dwell = (uint8_t)dwell;
+    s.flags = (charging_mode ? CONFIG_CHARGING : 0) |
+        (plugged_mode ? CONFIG_PLUGGED : 0) |
+        (ambient ? CONFIG_AMBIENT : 0) |
+        (tap_wake ? CONFIG_TAP_WAKE : 0) |
+        (trace_mode ? CONFIG_TRACE : 0) |
+        (battery_saver ? 0 : CONFIG_NO_SAVER) |
+        (usage_log ? CONFIG_USAGE : 0) |
+        (raw_accel ? CONFIG_RAW_ACCEL : 0);
+    s.schedule = schedule;
+    s.profile = wrist_profile;
+    s.detector = detector_kind;
+    s.awake_until = (int32_t)awake_until;
+
+    settings_pending = s;
+    settings_dirty = memcmp(&s, &settings_saved, sizeof(s)) != 0;
+}
+
+
+/*
+ * Write the settings if they changed, and tell a running worker to
+ * reload them with a WORKER_CONFIG message, so there is no restart and
+ * detection never stops.
+ */
+void
+flush_settings (void) 
+{
+    AppWorkerMessage msg = { 0 };
+
+    if (!settings_dirty)
+        return;
+
+    settings_save(&settings_pending);
+    settings_saved = settings_pending;
+    settings_dirty = false;
+
+    if (app_worker_is_running()) {
+        LOG(APP_LOG_LEVEL_DEBUG, "updating worker");
+        app_worker_send_message(WORKER_CONFIG, &msg);
+    }
+}
+
+
 /*
  * Main window menu
  */
 void top_menu_callback(int index, void *context);
 const SimpleMenuItem top_menu_items[]={
     {"Toggle backlight", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
-    {"Enable time", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
-    {"Disable time", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Weekday times", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Weekend times", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
     {"Set Timeout", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Raise delay", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
     {"Clear times", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
     {"Responsiveness", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Wake on tap", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
     {"Charging light", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
     {"Powered light", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
     {"Use light sensor", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Record trace", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Dump trace", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Dump log", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Calibrate", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Energy use", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Battery saver", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Usage log", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Wrist", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Raw samples", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
+    {"Raise motion", NULL, NULL, (SimpleMenuLayerSelectCallback)top_menu_callback},
 };
 #define num_top_menu_items (sizeof(top_menu_items) / sizeof(*top_menu_items))
 
@@ -96,134 +169,283 @@ const SimpleMenuSection top_menu_sections={.title="Main menu", .items=top_menu_i
  ****************************************************************************/
 
 
+/*
+ * Wakeup slot planner.
+ *
+ * The system refuses (E_RANGE) a wakeup within a minute of any other
+ * app's, and allows an app at most 8.  We only ever hold two, one per
+ * TIME_START/TIME_STOP, and keep their times in wakeup_slot[] so our own
+ * pair is kept apart without asking the system.  A foreign wakeup that
+ * collides with time t lies within a minute of it, so each retry steps
+ * two minutes earlier, which clears that one but may land on another.
+ * After WAKEUP_TRIES refusals plan_wakeup() gives up and returns the
+ * error, and no wakeup is booked for that time.
+ */
+#define WAKEUP_SPACING	(1 * MINUTES)
+#define WAKEUP_TRIES	4
+/* the furthest plan_wakeup() moves a wakeup ahead of the time wanted */
+#define WAKEUP_DRIFT	((2 * WAKEUP_TRIES + 1) * WAKEUP_SPACING)
+
+time_t wakeup_slot[2];                  /* by TIME_START/TIME_STOP, 0 = free */
+WakeupId alarm_saved[2];                /* ids in persist, by TIME_START/TIME_STOP */
+
+/*
+ * Under START_RECORD: the start wakeup id, and the window start after
+ * the one it is booked for, so that a start wakeup can book its
+ * successor without loading the schedule.
+ */
+typedef struct __attribute__((__packed__)) {
+    int32_t id;
+    int32_t next;                       /* 0 = not known */
+} StartRecord;
+
+time_t next_start;                      /* window start after the booked one */
+time_t next_start_saved;                /* next_start in persist */
+
+static time_t
+clear_of_own_slot (time_t t, int which)
+{
+    time_t other = wakeup_slot[!which];
+
+    if (other && t > other - WAKEUP_SPACING && t < other + WAKEUP_SPACING)
+        return(other - WAKEUP_SPACING);
+    return(t);
+}
+
 WakeupId
-schedule_my_wakeup (time_t alarm_time,
-                    int alarm_num)
+plan_wakeup (time_t want, int which, int32_t *offset)
 {
-    WakeupId wake_id;
-    
-    /* Schedule a new (snooze) wakeup */
-    for (wake_id = E_RANGE ; wake_id == E_RANGE ; alarm_time -= (1 * MINUTES)) {
-        wake_id = wakeup_schedule(alarm_time,
-                                  alarm_num,
-                                  true);
-        app_log(APP_LOG_LEVEL_WARNING,
-                __FILE__,
-                __LINE__,
-                "My wakeup - Alarm for time %u (context=%d) set with id %d",
-                (uint)alarm_time, alarm_num, (int)wake_id);
-        if (wake_id > 0) break;
+    time_t t;
+    WakeupId id = E_RANGE;
+    int tries;
+
+    /* after a wakeup launch the table starts empty; ask about the other */
+    if (wakeup_slot[!which] == 0 &&
+        !wakeup_query((which == TIME_START) ? stop_alarm_id : start_alarm_id,
+                      &wakeup_slot[!which])) {
+        wakeup_slot[!which] = 0;
+    }
+
+    t = clear_of_own_slot(want, which);
+    for (tries = 0 ; tries < WAKEUP_TRIES ; tries++) {
+        id = wakeup_schedule(t, which, true);
+        if (id != E_RANGE)
+            break;
+        t = clear_of_own_slot(t - 2 * WAKEUP_SPACING, which);
+    }
+
+    if (id < 0) {
+        LOG(APP_LOG_LEVEL_ERROR, "no wakeup slot near %u: %d", (uint)want, (int)id);
+        wakeup_slot[which] = 0;
+        return(id);
+    }
+
+    wakeup_slot[which] = t;
+    *offset = (int32_t)(t - want);
+    return(id);
+}
+
+
+/*
+ * Keep a wakeup id in persist, skipping the flash write when the stored
+ * id is already the same.  The start id goes out with next_start.
+ */
+static void
+save_alarm (int which, int which_mem, WakeupId id)
+{
+    StartRecord rec;
+
+    if (alarm_saved[which] == id &&
+        (which == TIME_STOP || next_start == next_start_saved))
+        return;
+    if (which == TIME_START) {
+        rec.id = id;
+        rec.next = (int32_t)next_start;
+        persist_write_data(which_mem, &rec, sizeof(rec));
+        next_start_saved = next_start;
+    } else {
+        persist_write_int(which_mem, (uint32_t)id);
     }
+    alarm_saved[which] = id;
+}
+
+/*
+ * The window start after the given one.  One a week on is left out:
+ * clock_to_timestamp() looks no further than that from now.
+ */
+static time_t
+start_after (time_t start)
+{
+    time_t next = schedule_next_time(&sched_table, start, true);
 
-    return(wake_id);
+    return(next > start ? next : 0);
 }
 
 
+/*
+ * Set the wakeup for the next schedule edge of one kind after the given
+ * time.  Only the next edge is ever booked; each wakeup books its own
+ * successor.
+ */
 void
-schedule_wakeup (WakeupId *alarm_id,
-		 int hour, int min,
-		 int which, int which_mem) 
+schedule_wakeup (WakeupId *alarm_id, int which, int which_mem, time_t after) 
 {
-    time_t now;
-    struct tm *now_tick;
     time_t alarm_time;
-    int32_t time_inc;
-
-    now = time(0L);
-    now_tick = localtime(&now);
+    int32_t offset = 0;
 
     wakeup_cancel(*alarm_id);
-    time_inc = ((hour - now_tick->tm_hour) * HOURS) +
-	((min - now_tick->tm_min) * MINUTES) -
-	now_tick->tm_sec;
-
-    if (time_inc < 0) {
-        /* place it back into the future */
-        time_inc += 1 * DAYS;
-    }
-    app_log(APP_LOG_LEVEL_WARNING,
-	    __FILE__,
-	    __LINE__,
-	    "time increment is %d", (int)time_inc);
-
-    alarm_time = now + time_inc;
-
-    /* If the choosen alarm time is taken, make it a minute
-       earlier until it works */
-    for (*alarm_id = E_RANGE ; *alarm_id == E_RANGE ;
-         alarm_time -= (1 * MINUTES)) {
-        *alarm_id = schedule_my_wakeup(alarm_time, which);
-        app_log(APP_LOG_LEVEL_WARNING,
-                __FILE__,
-                __LINE__,
-                "wakeup_schedule returned %d", (int)*alarm_id);
+    wakeup_slot[which] = 0;
+
+    alarm_time = schedule_next_time(&sched_table, after, which == TIME_START);
+    if (!alarm_time) {
+        /* no windows, or always on */
+        *alarm_id = 0;
+        if (which == TIME_START)
+            next_start = 0;
+        save_alarm(which, which_mem, 0);
+        return;
     }
-    
-    persist_write_int(which_mem, (uint32_t)(*alarm_id));
+    LOG(APP_LOG_LEVEL_DEBUG, "next %s at %u",
+        (which == TIME_START) ? "start" : "stop", (uint)alarm_time);
+
+    *alarm_id = plan_wakeup(alarm_time, which, &offset);
+    if (*alarm_id >= 0 && offset != 0) {
+        LOG(APP_LOG_LEVEL_WARNING, "%s wakeup moved %d s to avoid a clash",
+            (which == TIME_START) ? "start" : "stop", (int)offset);
+    }
+
+    if (which == TIME_START)
+        next_start = (*alarm_id >= 0) ? start_after(alarm_time) : 0;
+    save_alarm(which, which_mem, *alarm_id);
 }
 
 
+/*
+ * Is the start wakeup already booked for the next window start, or as
+ * near before it as plan_wakeup() would have moved it?
+ */
+static bool
+start_booked (void)
+{
+    time_t want, at;
+
+    if (start_alarm_id <= 0 || !wakeup_query(start_alarm_id, &at))
+        return(false);
+    want = schedule_next_time(&sched_table, time(0L), true);
+    if (!want || at > want || want - at > WAKEUP_DRIFT)
+        return(false);
+    wakeup_slot[TIME_START] = at;
+    next_start = start_after(want);     /* the schedule may have changed */
+    save_alarm(TIME_START, START_RECORD, start_alarm_id);
+    return(true);
+}
+
+/*
+ * A running worker follows the schedule by itself, so wakeups are only
+ * a fallback: while the worker is stopped one is booked to launch it at
+ * the next window start, unless it already is.  Stop wakeups are no
+ * longer used; any left by an older version are cancelled.
+ */
 void
-save_and_initiate_timer (int which) 
+book_wakeups (bool running) 
 {
 
+    if (running) {
+        if (start_alarm_id)
+            wakeup_cancel(start_alarm_id);
+        wakeup_slot[TIME_START] = 0;
+        start_alarm_id = 0;
+        save_alarm(TIME_START, START_RECORD, 0);
+    } else if (!start_booked()) {
+        schedule_wakeup(&start_alarm_id, TIME_START, START_RECORD, time(0L));
+    }
 
-    if (which == TIME_START) {
-	persist_write_int(START_HOUR, (uint32_t)start_hour);
-	persist_write_int(START_MINUTE, (uint32_t)start_min);
+    if (stop_alarm_id) {
+        wakeup_cancel(stop_alarm_id);
+        wakeup_slot[TIME_STOP] = 0;
+        stop_alarm_id = 0;
+        save_alarm(TIME_STOP, STOP_ALARM, 0);
+    }
+}
+
+
+void update_worker(void);
+
+void
+save_and_initiate_timers (void) 
+{
 
-	schedule_wakeup(&start_alarm_id, start_hour, start_min, TIME_START, START_ALARM);
-    } else { /* TIME_STOP */
-	persist_write_int(STOP_HOUR, (uint32_t)stop_hour);
-	persist_write_int(STOP_MINUTE, (uint32_t)stop_min);
+    schedule_compile(&schedule, &sched_table);
 
-	schedule_wakeup(&stop_alarm_id, stop_hour, stop_min, TIME_STOP, STOP_ALARM);
+    /* Tell a running worker about the new schedule */
+    if (app_worker_is_running()) {
+        update_worker();
+    } else {
+        save_settings();
     }
 }
 
 
+static const char *profile_names[SCHED_PROFILES]={"Weekday", "Weekend"};
+
 void
 format_time (void) 
 {
 
     snprintf(time_select_text, sizeof(time_select_text),
-	     "Setting\n%s\n%02u:%02u",
+	     "%s %d\n%s\n%02u:%02u",
+	     profile_names[sched_profile],
+	     sched_window + 1,
 	     which[time_setting],
 	     time_select_hours,
 	     time_select_minutes);
 }
 
 
+void
+load_time (void) 
+{
+    SchedWindow *win = &schedule.win[sched_profile][sched_window];
+    int t = (time_setting == TIME_START) ? win->start : win->stop;
+
+    time_select_pointer = TIME_SELECT_HOURS;
+    time_select_hours = t / 60;
+    time_select_minutes = t % 60;
+    format_time();
+    text_layer_set_text(time_layer, time_select_text);
+}
+
+void update_window_menu(void);
+
+
 
 static void
 select_time_handler(ClickRecognizerRef recognizer, void *context) {
 
-    app_log(APP_LOG_LEVEL_WARNING,
-	    __FILE__,
-	    __LINE__,
-	    "Time Click select");
+    LOG(APP_LOG_LEVEL_DEBUG, "Time Click select");
 
     if (time_select_pointer == TIME_SELECT_HOURS) {
 	time_select_pointer = TIME_SELECT_MINUTES;
         layer_mark_dirty(line_layer);
     } else {
-	app_log(APP_LOG_LEVEL_WARNING,
-		__FILE__,
-		__LINE__,
-		"Time selected is '%s'", time_select_text);
+        SchedWindow *win = &schedule.win[sched_profile][sched_window];
+        uint16_t t = time_select_hours * 60 + time_select_minutes;
 
-	if (time_setting == TIME_START) {
-	    start_hour = time_select_hours;
-	    start_min = time_select_minutes;
+	LOG(APP_LOG_LEVEL_DEBUG, "Time selected is '%s'", time_select_text);
 
-	    save_and_initiate_timer(TIME_START);
-	} else {
-	    stop_hour = time_select_hours;
-	    stop_min = time_select_minutes;
+	if (time_setting == TIME_START) {
+	    win->start = t;
 
-	    save_and_initiate_timer(TIME_STOP);
+            /* on to the stop time of the same window */
+            time_setting = TIME_STOP;
+            load_time();
+            layer_mark_dirty(line_layer);
+            return;
 	}
-	
+
+        win->stop = t;
+        save_and_initiate_timers();
+        update_window_menu();
 	window_stack_pop(true);
     }
 }
@@ -338,17 +560,84 @@ set_time (int which)
     layer_add_child(window_get_root_layer(time_window), line_layer);
 
     time_setting = which;		/* which one we're setting */
-    time_select_pointer = TIME_SELECT_HOURS;
-    time_select_hours = (which == TIME_START) ? start_hour : stop_hour;
-    time_select_minutes = (which == TIME_START) ? start_min : stop_min;
-    format_time();
-    text_layer_set_text(time_layer, time_select_text);
+    load_time();
     window_set_click_config_provider(time_window, time_config_provider);
     
     window_stack_push(time_window, true);
 }
 
 
+/*
+ * Menu of the on/off windows of one profile.  Picking one sets its start
+ * and then its stop time; making them equal turns the window off.
+ */
+Window *sched_menu_window=NULL;
+SimpleMenuLayer *sched_menu_layer=NULL;
+SimpleMenuItem sched_menu_items[SCHED_WINDOWS];
+SimpleMenuSection sched_menu_section;
+char sched_menu_text[SCHED_WINDOWS][20];
+
+void
+update_window_menu (void) 
+{
+    SchedWindow *win;
+    int w;
+
+    for (w = 0 ; w < SCHED_WINDOWS ; w++) {
+        win = &schedule.win[sched_profile][w];
+        if (win->start == win->stop) {
+            snprintf(sched_menu_text[w], sizeof(sched_menu_text[w]), "Off");
+        } else {
+            snprintf(sched_menu_text[w], sizeof(sched_menu_text[w]),
+                     "%02u:%02u - %02u:%02u",
+                     win->start / 60, win->start % 60,
+                     win->stop / 60, win->stop % 60);
+        }
+    }
+    sched_menu_section.title = profile_names[sched_profile];
+    if (sched_menu_layer)
+        layer_mark_dirty(simple_menu_layer_get_layer(sched_menu_layer));
+}
+
+static void
+window_menu_callback (int index, void *context) 
+{
+
+    sched_window = index;
+    set_time(TIME_START);
+}
+
+void
+set_windows (int profile) 
+{
+    Layer *root;
+    int w;
+
+    sched_profile = profile;
+
+    if (!sched_menu_window) {
+        for (w = 0 ; w < SCHED_WINDOWS ; w++) {
+            sched_menu_items[w] = (SimpleMenuItem) {
+                .title = sched_menu_text[w],
+                .callback = window_menu_callback,
+            };
+        }
+        sched_menu_section.items = sched_menu_items;
+        sched_menu_section.num_items = SCHED_WINDOWS;
+
+        sched_menu_window = window_create();
+        root = window_get_root_layer(sched_menu_window);
+        sched_menu_layer = simple_menu_layer_create(layer_get_frame(root), sched_menu_window,
+                                                    &sched_menu_section, 1, NULL);
+        layer_add_child(root, simple_menu_layer_get_layer(sched_menu_layer));
+    }
+
+    update_window_menu();
+    simple_menu_layer_set_selected_index(sched_menu_layer, 0, false);
+    window_stack_push(sched_menu_window, true);
+}
+
+
 /***********************************************************/
 /* Routines for setting backlight duration information     */
 /***********************************************************/
@@ -357,46 +646,52 @@ set_time (int which)
 NumberWindow *number_window=NULL;
     
 
+/*
+ * Start the worker by hand.  Outside the schedule it would go straight
+ * back to sleep, so it is told to stay awake until the next window
+ * starts, from when the schedule has it again.  That time is part of
+ * the settings record, so it goes out with the settings, and only when
+ * it changed.
+ */
 void
-restart_worker (void) 
+launch_worker (void) 
 {
-    if (app_worker_is_running()) {
-        app_log(APP_LOG_LEVEL_WARNING,
-                __FILE__,
-                __LINE__,
-                "restarting worker");
-        app_worker_kill();
-        psleep(1000);                   /* wait a little while */
-        app_worker_launch();
-    } else {
-        app_worker_launch();
-    }
+    time_t now = time(0L);
+
+    awake_until = 0;
+    if (!schedule_active(&sched_table, now))
+        awake_until = schedule_next_time(&sched_table, now, true);
+    save_settings();
+    flush_settings();
+    app_worker_launch();
+}
+
+
+/*
+ * Get changed settings to the worker.  A stopped worker is started and
+ * reads them as it starts, so they are written first; a running one
+ * hears about them from flush_settings().
+ */
+void
+update_worker (void) 
+{
+
+    save_settings();
+
+    if (!app_worker_is_running())
+        launch_worker();
 }
 
 
 void
 number_window_select (NumberWindow *nw, void *context) 
 {
-    uint32_t val;
 
     time_duration = number_window_get_value(nw);
-    app_log(APP_LOG_LEVEL_WARNING,
-            __FILE__,
-            __LINE__,
-            "Number Window select: duration = %d", time_duration);
-
-    persist_write_int(DURATION, (uint32_t)time_duration);
-    val = persist_read_int(DURATION);
-    if (val) {
-        time_duration = (int)val;
-    }
-    app_log(APP_LOG_LEVEL_WARNING,
-            __FILE__,
-            __LINE__,
-            "duration re-read as %d", time_duration);
+    LOG(APP_LOG_LEVEL_DEBUG, "Number Window select: duration = %d", time_duration);
 
-    /* Restart worker, so we get the new values */
-    restart_worker();
+    /* Send the worker the new values */
+    update_worker();
 
     window_stack_pop(true);
     number_window_destroy(number_window);
@@ -423,10 +718,7 @@ set_timeout (void)
     number_window = number_window_create("Set Duration", number_window_callbacks, NULL);
 
     if (!number_window) {
-        app_log(APP_LOG_LEVEL_WARNING,
-                __FILE__,
-                __LINE__,
-                "Error creating number window");
+        LOG(APP_LOG_LEVEL_ERROR, "Error creating number window");
         return;                         /* internal error */
     }
     
@@ -438,15 +730,59 @@ set_timeout (void)
 }
 
 
+/*
+ * How long the watch must be held level before the light comes on
+ */
+void
+dwell_window_select (NumberWindow *nw, void *context) 
+{
+
+    dwell = number_window_get_value(nw);
+    LOG(APP_LOG_LEVEL_DEBUG, "Number Window select: dwell = %d", dwell);
+
+    /* Send the worker the new values */
+    update_worker();
+
+    window_stack_pop(true);
+    number_window_destroy(number_window);
+    number_window = NULL;
+}
+
+NumberWindowCallbacks dwell_window_callbacks={
+    NULL,
+    NULL,
+    dwell_window_select
+};
+
+
+void
+set_dwell (void) 
+{
+
+    if (number_window) {
+        number_window_destroy(number_window);
+    }
+    number_window = number_window_create("Delay 1/10 sec", dwell_window_callbacks, NULL);
+
+    if (!number_window) {
+        LOG(APP_LOG_LEVEL_ERROR, "Error creating number window");
+        return;                         /* internal error */
+    }
+    
+    number_window_set_max(number_window, 30);
+    number_window_set_min(number_window, 0);
+    number_window_set_value(number_window, dwell);
+
+    window_stack_push((Window *)number_window, true);
+}
+
+
 void
 clear_times (void) 
 {
-    start_hour = 0;
-    start_min = 0;
-    stop_hour = 0;
-    stop_min = 0;
-    save_and_initiate_timer(TIME_START);
-    save_and_initiate_timer(TIME_STOP);
+
+    schedule_clear(&schedule);
+    save_and_initiate_timers();
 }
 
 void
@@ -462,32 +798,13 @@ destroy_samples_window(void)
 static void
 select_sample_handler(ClickRecognizerRef recognizer, void *context) {
 
-    uint32_t val;
-
-    app_log(APP_LOG_LEVEL_WARNING,
-            __FILE__,
-            __LINE__,
-            "Samples Window select: samples = %d", samples);
-
-    persist_write_int(SAMPLES, (uint32_t)samples);
-    val = persist_read_int(SAMPLES);
-    if (val) {
-        samples = (int)val;
-    }
-    app_log(APP_LOG_LEVEL_WARNING,
-            __FILE__,
-            __LINE__,
-            "samples re-read as %d", samples);
+    LOG(APP_LOG_LEVEL_DEBUG, "Samples Window select: samples = %d", samples);
 
-    /* Restart worker, so we get the new values */
+    /* Tell a running worker about the new value */
     if (app_worker_is_running()) {
-        app_log(APP_LOG_LEVEL_WARNING,
-                __FILE__,
-                __LINE__,
-                "restarting worker");
-        app_worker_kill();
-        psleep(1000);                   /* wait a little while */
-        app_worker_launch();
+        update_worker();
+    } else {
+        save_settings();
     }
 
     window_stack_pop(true);
@@ -538,10 +855,7 @@ void
 set_samples (void) 
 {
 
-    app_log(APP_LOG_LEVEL_WARNING,
-            __FILE__,
-            __LINE__,
-            "set_samples");
+    LOG(APP_LOG_LEVEL_DEBUG, "set_samples");
     /*
      * Create a window for setting a number
      */
@@ -549,10 +863,7 @@ set_samples (void)
         destroy_samples_window();
     }
 
-    app_log(APP_LOG_LEVEL_WARNING,
-            __FILE__,
-            __LINE__,
-            "set_samples 2");
+    LOG(APP_LOG_LEVEL_DEBUG, "set_samples 2");
     /*
      * Create the base window
      */
@@ -585,6 +896,50 @@ set_samples (void)
 }
 
 
+/*
+ * Toggle tap wake mode: the worker leaves the accelerometer off until
+ * a tap, saving battery at the cost of needing a flick of the wrist.
+ */
+static void
+set_tap_wake (void) 
+{
+    static char buffer[40];
+
+    if (tap_wake) {
+        tap_wake = false;
+    } else {
+        tap_wake = true;
+    }
+
+    snprintf(buffer, sizeof(buffer), "Wake on tap is %s",
+             tap_wake ? "on" : "off");
+    text_layer_set_text(text_layer, buffer);
+
+    update_worker();
+}
+
+/*
+ * Toggle the worker's battery policy: shorter light, slower sampling and
+ * finally tap wake as the charge drops below 30%, 20% and 10%.
+ */
+static void
+set_battery_saver (void) 
+{
+    static char buffer[40];
+
+    if (battery_saver) {
+        battery_saver = false;
+    } else {
+        battery_saver = true;
+    }
+
+    snprintf(buffer, sizeof(buffer), "Battery saver is %s",
+             battery_saver ? "on" : "off");
+    text_layer_set_text(text_layer, buffer);
+
+    update_worker();
+}
+
 /*
  * Toggle "on while charging" mode
  */
@@ -599,13 +954,12 @@ on_while_charging (void)
         charging_mode = true;
     }
 
-    persist_write_bool(CHARGING, charging_mode);
 
     snprintf(buffer, sizeof(buffer), "Light will be %s during charging",
              charging_mode ? "on" : "off");
     text_layer_set_text(text_layer, buffer);
 
-    restart_worker();
+    update_worker();
 }
 
 /*
@@ -622,13 +976,12 @@ on_while_plugged (void)
         plugged_mode = true;
     }
 
-    persist_write_bool(PLUGGED, plugged_mode);
 
     snprintf(buffer, sizeof(buffer), "Light will be %s while plugged in",
              plugged_mode ? "on" : "off");
     text_layer_set_text(text_layer, buffer);
 
-    restart_worker();
+    update_worker();
 }
 
 
@@ -647,12 +1000,276 @@ set_ambient (void)
         ambient = true;
     }
 
-    persist_write_bool(AMBIENT, ambient);
     snprintf(buffer, sizeof(buffer), "Use of ambient light sensor is %s",
              ambient ? "on" : "off");
     text_layer_set_text(text_layer, buffer);
 
-    restart_worker();
+    update_worker();
+}
+
+
+/*
+ * Toggle recording of accelerometer traces in the worker
+ */
+static void
+set_trace (void) 
+{
+    static char buffer[40];
+
+    if (trace_mode) {
+        trace_mode = false;
+    } else {
+        trace_mode = true;
+    }
+
+    snprintf(buffer, sizeof(buffer), "Trace recording is %s",
+             trace_mode ? "on" : "off");
+    text_layer_set_text(text_layer, buffer);
+
+    update_worker();
+}
+
+/*
+ * Toggle the worker's usage records, sent to the phone by data logging
+ * for looking at light use over weeks (see worker_src/usage.h)
+ */
+static void
+set_usage_log (void) 
+{
+    static char buffer[40];
+
+    if (usage_log) {
+        usage_log = false;
+    } else {
+        usage_log = true;
+    }
+
+    snprintf(buffer, sizeof(buffer), "Usage log is %s",
+             usage_log ? "on" : "off");
+    text_layer_set_text(text_layer, buffer);
+
+    update_worker();
+}
+
+/*
+ * Step through the ways of wearing the watch.  The box is the original
+ * check, fitted to the wearer by "Calibrate"; the others test the angle
+ * to a viewing direction using all three axes.
+ */
+static void
+set_wrist (void) 
+{
+    static const char *names[PROFILES] = {
+        [PROFILE_BOX] = "calibrated box",
+        [PROFILE_LEFT] = "left wrist",
+        [PROFILE_RIGHT] = "right wrist",
+        [PROFILE_LEFT_INVERTED] = "left wrist, inverted",
+        [PROFILE_RIGHT_INVERTED] = "right wrist, inverted",
+    };
+    static char buffer[40];
+
+    wrist_profile = (wrist_profile + 1) % PROFILES;
+
+    snprintf(buffer, sizeof(buffer), "Posture: %s", names[wrist_profile]);
+    text_layer_set_text(text_layer, buffer);
+
+    update_worker();
+}
+
+/*
+ * Toggle the worker's raw accel samples: less to copy per batch, but
+ * samples taken while the watch vibrates are no longer skipped
+ */
+static void
+set_raw_accel (void) 
+{
+    static char buffer[40];
+
+    if (raw_accel) {
+        raw_accel = false;
+    } else {
+        raw_accel = true;
+    }
+
+    snprintf(buffer, sizeof(buffer), "Raw samples are %s",
+             raw_accel ? "on" : "off");
+    text_layer_set_text(text_layer, buffer);
+
+    update_worker();
+}
+
+/*
+ * Toggle needing a raise into the viewing posture, rather than only
+ * holding it, so that a wrist kept still in view (reading in bed,
+ * steering) doesn't light the watch
+ */
+static void
+set_raise_motion (void) 
+{
+    static char buffer[40];
+
+    if (detector_kind == DETECTOR_RAISE) {
+        detector_kind = DETECTOR_POSTURE;
+    } else {
+        detector_kind = DETECTOR_RAISE;
+    }
+
+    snprintf(buffer, sizeof(buffer), "Light on %s",
+             detector_kind == DETECTOR_RAISE ? "a raise" : "the posture");
+    text_layer_set_text(text_layer, buffer);
+
+    update_worker();
+}
+
+/*
+ * Ask the worker to write its trace to the log
+ */
+static void
+dump_trace (void) 
+{
+    AppWorkerMessage msg = { 0 };
+
+    if (!trace_mode || !app_worker_is_running()) {
+        text_layer_set_text(text_layer, "No trace being recorded");
+        return;
+    }
+
+    app_worker_send_message(WORKER_DUMP_TRACE, &msg);
+    text_layer_set_text(text_layer, "Trace sent to log");
+}
+
+
+/*
+ * Ask the worker for its event log; entries come back one worker
+ * message each and are logged here, so the worker never formats them.
+ */
+static const char *evlog_names[]={
+    "?", "light on", "light off", "charging", "plugged",
+    "unplugged", "rate", "start", "timeout", "sleep", "wake",
+    "calibration raise", "calibrated", "battery policy",
+};
+
+static void
+dump_log (void) 
+{
+    AppWorkerMessage msg = { 0 };
+
+    if (!app_worker_is_running()) {
+        text_layer_set_text(text_layer, "Backlight is not running");
+        return;
+    }
+
+    app_worker_send_message(WORKER_DUMP_LOG, &msg);
+    text_layer_set_text(text_layer, "Fetching log");
+}
+
+/*
+ * Have the worker fit the viewing posture to the next few raises
+ */
+static void
+calibrate (void) 
+{
+    AppWorkerMessage msg = { 0 };
+    static char buffer[60];
+
+    if (!app_worker_is_running()) {
+        text_layer_set_text(text_layer, "Backlight is not running");
+        return;
+    }
+
+    /* the fitted box is what calibration changes */
+    wrist_profile = PROFILE_BOX;
+    save_settings();
+    flush_settings();
+
+    app_worker_send_message(WORKER_CALIBRATE, &msg);
+    snprintf(buffer, sizeof(buffer),
+             "Raise and hold the watch %d times", CAL_RAISES);
+    text_layer_set_text(text_layer, buffer);
+}
+
+/*
+ * Energy use: the worker's counters, fetched with WORKER_STATS and shown
+ * in their own window once the last one has arrived.
+ */
+Window *stats_window=NULL;
+TextLayer *stats_layer=NULL;
+uint32_t stats[STATS_COUNT];
+char stats_text[160];
+
+static void
+show_stats (void) 
+{
+    uint32_t lit = stats[STATS_ON_RAISE] / 1000;
+
+    snprintf(stats_text, sizeof(stats_text),
+             "Running %luh%02lum\n"
+             "Raise lit %lum%02lus\n"
+             "Charging lit %lum\n"
+             "Plugged lit %lum\n"
+             "Batches %lu\n"
+             "Raises %lu, short %lu",
+             (unsigned long)(stats[STATS_UPTIME] / 3600),
+             (unsigned long)(stats[STATS_UPTIME] / 60 % 60),
+             (unsigned long)(lit / 60), (unsigned long)(lit % 60),
+             (unsigned long)(stats[STATS_ON_CHARGING] / 60000),
+             (unsigned long)(stats[STATS_ON_PLUGGED] / 60000),
+             (unsigned long)stats[STATS_BATCHES],
+             (unsigned long)stats[STATS_RAISES],
+             (unsigned long)stats[STATS_SHORT]);
+
+    if (!stats_window) {
+        stats_window = window_create();
+        stats_layer = text_layer_create(layer_get_bounds(window_get_root_layer(stats_window)));
+        text_layer_set_font(stats_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD));
+        text_layer_set_text_alignment(stats_layer, GTextAlignmentCenter);
+        layer_add_child(window_get_root_layer(stats_window), text_layer_get_layer(stats_layer));
+    }
+    text_layer_set_text(stats_layer, stats_text);
+    if (window_stack_get_top_window() != stats_window)
+        window_stack_push(stats_window, true);
+}
+
+static void
+fetch_stats (void) 
+{
+    AppWorkerMessage msg = { 0 };
+
+    if (!app_worker_is_running()) {
+        text_layer_set_text(text_layer, "Backlight is not running");
+        return;
+    }
+
+    memset(stats, 0, sizeof(stats));
+    app_worker_send_message(WORKER_STATS, &msg);
+    text_layer_set_text(text_layer, "Fetching energy use");
+}
+
+static void
+worker_message_handler (uint16_t type, AppWorkerMessage *data) 
+{
+
+    if (type == WORKER_STATS) {
+        if (data->data0 == STATS_END)
+            show_stats();
+        else if (data->data0 < STATS_COUNT)
+            stats[data->data0] = data->data1 | ((uint32_t)data->data2 << 16);
+        return;
+    }
+
+    if (type != WORKER_DUMP_LOG)
+        return;
+
+    if (data->data0 == EVLOG_END) {
+        if (text_layer)
+            text_layer_set_text(text_layer, "Worker log dumped");
+        return;
+    }
+    /* see evlog_send() */
+    APP_LOG(APP_LOG_LEVEL_INFO, "evlog %5u %s %u",
+            (uint)(data->data2 | (uint32_t)(data->data1 >> 8) << 16),
+            data->data0 < ARRAY_LENGTH(evlog_names) ? evlog_names[data->data0] : "?",
+            (uint)(data->data1 & 0xff));
 }
 
 
@@ -663,65 +1280,101 @@ void
 top_menu_callback (int index, void *context) 
 {
     
-    app_log(APP_LOG_LEVEL_WARNING,
-	    __FILE__,
-	    __LINE__,
-	    "Main Menu callback on row %d\n", index);
+    LOG(APP_LOG_LEVEL_DEBUG, "Main Menu callback on row %d\n", index);
 
     switch ( index ) {
     case 0:				/* toggle auto-backlight */
-        app_log(APP_LOG_LEVEL_WARNING,
-                __FILE__,
-                __LINE__,
-                "Toggling backlight");
+        LOG(APP_LOG_LEVEL_DEBUG, "Toggling backlight");
 	if (app_worker_is_running()) {
-            app_log(APP_LOG_LEVEL_WARNING,
-                    __FILE__,
-                    __LINE__,
-                    "Toggling backlight off");
+            LOG(APP_LOG_LEVEL_DEBUG, "Toggling backlight off");
 	    text_layer_set_text(text_layer, "Light off");
 	    app_worker_kill();
 	} else {
-            app_log(APP_LOG_LEVEL_WARNING,
-                    __FILE__,
-                    __LINE__,
-                    "Toggling backlight on");
+            LOG(APP_LOG_LEVEL_DEBUG, "Toggling backlight on");
 	    text_layer_set_text(text_layer, "Light on");
-	    app_worker_launch();
+	    launch_worker();
 	}
 	break;
 
-    case 1:				/* Set Start Time */
-	set_time(TIME_START);
+    case 1:				/* Weekday windows */
+	set_windows(SCHED_WEEKDAY);
 	return;
 
-    case 2:				/* Set Start Time */
-	set_time(TIME_STOP);
+    case 2:				/* Weekend windows */
+	set_windows(SCHED_WEEKEND);
 	return;
 
     case 3:				/* Set Timeout */
 	set_timeout();
 	return;
 
-    case 4:				/* Clear times */
+    case 4:				/* Raise delay */
+	set_dwell();
+	return;
+
+    case 5:				/* Clear times */
 	clear_times();
 	return;
 
-    case 5:				/* Samples per callback */
+    case 6:				/* Samples per callback */
 	set_samples();
 	return;
 
-    case 6:
+    case 7:
+        set_tap_wake();              /* accel only after a tap */
+        break;
+
+    case 8:
         on_while_charging();            /* keep light on while charging */
         break;
 
-    case 7:
+    case 9:
         on_while_plugged();            /* keep light on while powered */
         break;
 
-    case 8:
+    case 10:
         set_ambient();               /* Use ambient light control */
         break;
+
+    case 11:
+        set_trace();                 /* record accel traces */
+        break;
+
+    case 12:
+        dump_trace();                /* send trace to the log */
+        break;
+
+    case 13:
+        dump_log();                  /* send worker events to the log */
+        break;
+
+    case 14:
+        calibrate();                 /* fit the posture box */
+        break;
+
+    case 15:
+        fetch_stats();               /* show what the light costs */
+        break;
+
+    case 16:
+        set_battery_saver();         /* back off on a low battery */
+        break;
+
+    case 17:
+        set_usage_log();             /* light use through data logging */
+        break;
+
+    case 18:
+        set_wrist();                 /* how the watch is worn */
+        break;
+
+    case 19:
+        set_raw_accel();             /* lean sample batches */
+        break;
+
+    case 20:
+        set_raise_motion();          /* a raise, not just the posture */
+        break;
     }
 
     window_stack_pop(true); /* menu window */
@@ -729,10 +1382,17 @@ top_menu_callback (int index, void *context)
 
 static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
 
-    app_log(APP_LOG_LEVEL_WARNING,
-	    __FILE__,
-	    __LINE__,
-	    "Top Click handler");
+    LOG(APP_LOG_LEVEL_DEBUG, "Top Click handler");
+
+    /* Built on first use: most launches never open the menu */
+    if (top_menu_window == NULL) {
+        top_menu_window = window_create();
+        top_menu_layer = simple_menu_layer_create(layer_get_frame(window_get_root_layer(window)),
+                                                  top_menu_window, &top_menu_sections,
+                                                  num_top_menu_sections, NULL);
+        layer_add_child(window_get_root_layer(top_menu_window),
+                        simple_menu_layer_get_layer(top_menu_layer));
+    }
 
     window_stack_push(top_menu_window, true);
     text_layer_set_text_alignment(text_layer, GTextAlignmentCenter);
@@ -742,20 +1402,14 @@ static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
 
 static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
 
-    app_log(APP_LOG_LEVEL_WARNING,
-            __FILE__,
-            __LINE__,
-            "Turning backlight on");
-    app_worker_launch();
+    LOG(APP_LOG_LEVEL_DEBUG, "Turning backlight on");
+    launch_worker();
     text_layer_set_text(text_layer, "Light on");
 }
 
 static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
 
-    app_log(APP_LOG_LEVEL_WARNING,
-            __FILE__,
-            __LINE__,
-            "Turning backlight off");
+    LOG(APP_LOG_LEVEL_DEBUG, "Turning backlight off");
     app_worker_kill();
     text_layer_set_text(text_layer, "Light off");
 }
@@ -783,6 +1437,11 @@ static void window_load(Window *window) {
   layer_add_child(window_layer, text_layer_get_layer(text_layer));
 }
 
+/* Back from the menus: write whatever was changed there */
+static void window_appear(Window *window) {
+  flush_settings();
+}
+
 static void window_unload(Window *window) {
   text_layer_destroy(text_layer);
   text_layer = NULL;
@@ -793,24 +1452,18 @@ static void init(void) {
   window_set_click_config_provider(window, click_config_provider);
   window_set_window_handlers(window, (WindowHandlers) {
     .load = window_load,
+    .appear = window_appear,
     .unload = window_unload,
   });
   const bool animated = true;
 
-  Layer *window_layer = window_get_root_layer(window);
-
 //  text_layer = text_layer_create((GRect) { .origin = { 0, 0 }, .size = { bounds.size.w, bounds.size.h } });
 
   my_font = fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD);
 
-/*
- * Create the top level menu
- */
-  top_menu_window = window_create();
-  top_menu_layer = simple_menu_layer_create(layer_get_frame(window_layer), top_menu_window,
-					    &top_menu_sections, num_top_menu_sections, NULL);
-  layer_add_child(window_get_root_layer(top_menu_window), simple_menu_layer_get_layer(top_menu_layer));
+  /* The top level menu is only built when first opened */
 
+  app_worker_message_subscribe(worker_message_handler);
 
 /*
  * Start main window
@@ -831,140 +1484,214 @@ static void deinit(void) {
       window_destroy(sample_window);
   if (sample_layer)
       text_layer_destroy(sample_layer);
+  if (stats_layer)
+      text_layer_destroy(stats_layer);
+  if (stats_window)
+      window_destroy(stats_window);
+  if (sched_menu_layer)
+      simple_menu_layer_destroy(sched_menu_layer);
+  if (sched_menu_window)
+      window_destroy(sched_menu_window);
   if (text_layer)
       text_layer_destroy(text_layer);
   if (top_menu_layer)
       simple_menu_layer_destroy(top_menu_layer);
   if (top_menu_window)
       window_destroy(top_menu_window);
+  top_menu_layer = NULL;
+  top_menu_window = NULL;
   window_destroy(window);
 }
 
 void
 read_alarm_data (void) 
 {
+    Settings s;
+    StartRecord rec;
     uint32_t val;
     
-    val = persist_read_int(START_ALARM);
-    if (val) {
-	start_alarm_id = (WakeupId)val;
-	APP_LOG(APP_LOG_LEVEL_DEBUG, "start_alarm_id=%u", (uint)val);
+    if (persist_read_data(START_RECORD, &rec, sizeof(rec)) != sizeof(rec)) {
+        /* first run since the record came in */
+        rec.id = persist_read_int(START_ALARM);
+        rec.next = 0;
+        persist_write_data(START_RECORD, &rec, sizeof(rec));
+        persist_delete(START_ALARM);
+    }
+    alarm_saved[TIME_START] = (WakeupId)rec.id;
+    next_start = next_start_saved = (time_t)rec.next;
+    if (rec.id) {
+	start_alarm_id = (WakeupId)rec.id;
+	LOG(APP_LOG_LEVEL_DEBUG, "start_alarm_id=%u", (uint)rec.id);
     }
 
     val = persist_read_int(STOP_ALARM);
+    alarm_saved[TIME_STOP] = (WakeupId)val;
     if (val) {
 	stop_alarm_id = (WakeupId)val;
-	APP_LOG(APP_LOG_LEVEL_DEBUG, "stop_alarm_id=%u", (uint)val);
+	LOG(APP_LOG_LEVEL_DEBUG, "stop_alarm_id=%u", (uint)val);
     }
 
-    val = persist_read_int(START_HOUR);
-    if (val) {
-	start_hour = (int)val;
-	APP_LOG(APP_LOG_LEVEL_DEBUG, "start_hour=%u", (uint)val);
-    }
-    val = persist_read_int(START_MINUTE);
-    if (val) {
-	start_min = (int)val;
-	APP_LOG(APP_LOG_LEVEL_DEBUG, "start_min=%u", (uint)val);
+    if (!settings_load(&s)) {
+        /* first run since settings became one record */
+        LOG(APP_LOG_LEVEL_DEBUG, "migrating settings");
+        settings_save(&s);
+        settings_delete_legacy();
     }
+    settings_saved = s;
+    schedule = s.schedule;
+    schedule_compile(&schedule, &sched_table);
+    time_duration = s.duration;
+    samples = s.samples;
+    dwell = s.dwell;
+    charging_mode = (s.flags & CONFIG_CHARGING) != 0;
+    plugged_mode = (s.flags & CONFIG_PLUGGED) != 0;
+    ambient = (s.flags & CONFIG_AMBIENT) != 0;
+    tap_wake = (s.flags & CONFIG_TAP_WAKE) != 0;
+    trace_mode = (s.flags & CONFIG_TRACE) != 0;
+    battery_saver = (s.flags & CONFIG_NO_SAVER) == 0;
+    usage_log = (s.flags & CONFIG_USAGE) != 0;
+    raw_accel = (s.flags & CONFIG_RAW_ACCEL) != 0;
+    wrist_profile = s.profile < PROFILES ? s.profile : PROFILE_BOX;
+    detector_kind = s.detector < DETECTORS ? s.detector : DETECTOR_POSTURE;
+    awake_until = (time_t)s.awake_until;
+    LOG(APP_LOG_LEVEL_DEBUG, "settings: %u edges duration=%u samples=%u dwell=%u flags=%x",
+        sched_table.count, s.duration, s.samples, s.dwell, s.flags);
+}
 
-    val = persist_read_int(STOP_HOUR);
-    if (val) {
-	stop_hour = (int)val;
-	APP_LOG(APP_LOG_LEVEL_DEBUG, "stop_hour=%u", (uint)val);
-    }
-    val = persist_read_int(STOP_MINUTE);
-    if (val) {
-	stop_min = (int)val;
-	APP_LOG(APP_LOG_LEVEL_DEBUG, "stop_min=%u", (uint)val);
-    }
-    if (persist_exists(DURATION)) {
-        val = persist_read_int(DURATION);
-        if (val) {
-            time_duration = (int)val;
-            APP_LOG(APP_LOG_LEVEL_DEBUG, "time_duration=%u", (uint)val);
-        }
-    } else {
-        time_duration = 5;              /* default */
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "init time_duration=5");
-    }
-    if (persist_exists(SAMPLES)) {
-        val = persist_read_int(SAMPLES);
-        if (val) {
-            samples = (int)val;
-            APP_LOG(APP_LOG_LEVEL_DEBUG, "samples=%u", (uint)val);
-        }
+
+/*
+ * A start wakeup only has to launch the worker, so it skips the settings
+ * and the schedule: START_RECORD is read, and written back with the
+ * spent id cleared.  Should the launch be refused (the user is asked
+ * first while another app's worker runs) the next start is booked from
+ * the record, and only without a usable one is the schedule loaded.
+ */
+static void
+start_wakeup (void) 
+{
+    StartRecord rec;
+    AppWorkerResult res;
+    int32_t offset = 0;
+
+    if (persist_read_data(START_RECORD, &rec, sizeof(rec)) == sizeof(rec)) {
+        alarm_saved[TIME_START] = (WakeupId)rec.id;
+        next_start = next_start_saved = (time_t)rec.next;
     } else {
-        samples = 1;              /* default */
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "init samples=1");
+        read_alarm_data();              /* once, to move START_ALARM over */
     }
-    val = persist_read_bool(CHARGING);
-    if (val) {
-	charging_mode = (bool)val;
-	APP_LOG(APP_LOG_LEVEL_DEBUG, "charging_mode=%u", (uint)charging_mode);
+
+    res = app_worker_launch();
+    if (res == APP_WORKER_RESULT_SUCCESS ||
+        res == APP_WORKER_RESULT_ALREADY_RUNNING) {
+        LOG(APP_LOG_LEVEL_DEBUG, "Start backlight");
+        save_alarm(TIME_START, START_RECORD, 0);
+        return;
     }
-    val = persist_read_bool(PLUGGED);
-    if (val) {
-	plugged_mode = (bool)val;
-	APP_LOG(APP_LOG_LEVEL_DEBUG, "plugged_mode=%u", (uint)plugged_mode);
+    LOG(APP_LOG_LEVEL_WARNING, "worker launch refused: %d", (int)res);
+
+    if (next_start - time(0L) > WAKEUP_DRIFT) {
+        start_alarm_id = plan_wakeup(next_start, TIME_START, &offset);
+        if (start_alarm_id >= 0) {
+            save_alarm(TIME_START, START_RECORD, start_alarm_id);
+            return;
+        }
     }
-}
 
+    /*
+     * No next start kept, or it is the one just passed.  The wakeup may
+     * have come up to WAKEUP_DRIFT early, so book from past the window
+     * start it was for, not that same start again.
+     */
+    read_alarm_data();
+    start_alarm_id = 0;                 /* spent */
+    schedule_wakeup(&start_alarm_id, TIME_START, START_RECORD,
+                    time(0L) + WAKEUP_DRIFT);
+}
 
+/*
+ * Only reached when the worker was not running at a window start, or for
+ * a stop wakeup booked by an older version; the worker sleeps by itself.
+ */
 void
 handle_wakeup (WakeupId id, int32_t cookie) 
 {
 
     if (cookie == TIME_START) {
-        app_log(APP_LOG_LEVEL_WARNING,
-                __FILE__,
-                __LINE__,
-                "Start backlight");
-	app_worker_launch();
-	wakeup_cancel(start_alarm_id);
-	schedule_wakeup(&start_alarm_id, start_hour, start_min, TIME_START, START_ALARM);
-    } else { /* TIME_STOP */
-        app_log(APP_LOG_LEVEL_WARNING,
-                __FILE__,
-                __LINE__,
-                "Stop backlight");
+        start_wakeup();
+        return;
+    }
+    read_alarm_data();
+    stop_alarm_id = 0;                  /* spent */
+    book_wakeups(app_worker_is_running());
+}
+
+
+
+/*
+ * From quick launch the app only toggles the worker, with no window at
+ * all: a short buzz for on, a double one for off.
+ */
+void
+quick_toggle (void) 
+{
+    bool running = app_worker_is_running();
 
-        light_enable(false);            /* make sure it's off */
-	app_worker_kill();
-	wakeup_cancel(stop_alarm_id);
-	schedule_wakeup(&stop_alarm_id, stop_hour, stop_min, TIME_STOP, STOP_ALARM);
+    if (running) {
+        LOG(APP_LOG_LEVEL_DEBUG, "Quick toggle off");
+        app_worker_kill();
+        vibes_double_pulse();
+    } else {
+        LOG(APP_LOG_LEVEL_DEBUG, "Quick toggle on");
+        launch_worker();
+        vibes_short_pulse();
     }
+    book_wakeups(!running);
 }
 
 
 
+static uint32_t
+now_ms (void) 
+{
+    time_t s;
+    uint16_t ms;
+
+    time_ms(&s, &ms);
+    return((uint32_t)s * 1000 + ms);
+}
+
+
 int main(void) {
     AppLaunchReason reason;
     WakeupId id = 0;
     int32_t cookie;
+    uint32_t t0;
 
     reason = launch_reason();
 
-    app_log(APP_LOG_LEVEL_WARNING,
-            __FILE__,
-            __LINE__,
-            "Backlight - launch_reason=%d", (int)reason);
+    LOG(APP_LOG_LEVEL_DEBUG, "Backlight - launch_reason=%d", (int)reason);
 
     if (reason == APP_LAUNCH_WAKEUP) {
+        t0 = now_ms();
 	wakeup_get_launch_event(&id, &cookie);
-	read_alarm_data();
 	handle_wakeup(id, cookie);
+        /* not LOG(): the cost of a wakeup launch is wanted in every build */
+        APP_LOG(APP_LOG_LEVEL_INFO, "wakeup launch took %u ms", (uint)(now_ms() - t0));
+    } else if (reason == APP_LAUNCH_QUICK_LAUNCH) {
+	read_alarm_data();
+        quick_toggle();
     } else {
         init();
 	read_alarm_data();
-        wakeup_cancel_all();            /* complete reset */
-        save_and_initiate_timer(TIME_START);
-        save_and_initiate_timer(TIME_STOP);
-        restart_worker();
+        /* wakeups are left as booked: book_wakeups() sorts them out on exit */
+        update_worker();
 	
-	APP_LOG(APP_LOG_LEVEL_DEBUG, "Done initializing, pushed window: %p", window);
+	LOG(APP_LOG_LEVEL_DEBUG, "Done initializing, pushed window: %p", window);
 	
 	app_event_loop();
+        flush_settings();
+        book_wakeups(app_worker_is_running());
 	deinit();
     }
+    return 0;
 }
@@ -0,0 +1,226 @@
+/*
+ * Settings shared by the app and the worker.
+ *
+ * All settings live in one packed, versioned record under SETTINGS_KEY,
+ * read and written with a single persist call.  The wakeup ids are kept
+ * in their own keys since only the app uses them.
+ *
+ * Include after pebble.h or pebble_worker.h.
+ */
+#pragma once
+
+#include "schedule.h"
+
+/* Persist keys */
+#define START_ALARM	4       /* start wakeup id, until START_RECORD */
+#define STOP_ALARM	5
+#define SETTINGS_KEY	14
+#define CALIBRATION_KEY	15      /* worker only: fitted posture box */
+#define START_RECORD	16      /* app only: start wakeup and the next start */
+
+/* Legacy persist keys, one per setting, read once to migrate */
+#define START_HOUR	0
+#define START_MINUTE	1
+#define STOP_HOUR	2
+#define STOP_MINUTE	3
+#define DURATION	6
+#define SAMPLES		7
+#define CHARGING	8
+#define PLUGGED		9
+#define AMBIENT		10
+#define TRACE		11
+#define TAP_WAKE	12
+#define DWELL		13
+#define AWAKE_UNTIL	17      /* Settings.awake_until before version 5 */
+
+/* Message types sent from the app to the worker */
+#define WORKER_DUMP_TRACE	1
+#define WORKER_DUMP_LOG		2       /* the worker answers with the same type */
+#define WORKER_CONFIG		3       /* settings record changed, reload it */
+#define WORKER_CALIBRATE	4       /* fit the posture box to the next raises */
+
+#define CAL_RAISES		5       /* raises taken by a calibration */
+
+/*
+ * WORKER_STATS is answered with one message of the same type per counter,
+ * data0 = STATS_*, data1 and data2 = low and high 16 bits, then STATS_END.
+ */
+#define WORKER_STATS		5
+
+#define STATS_UPTIME		0       /* seconds since the worker started */
+#define STATS_ON_RAISE		1       /* light on ms, by reason */
+#define STATS_ON_CHARGING	2
+#define STATS_ON_PLUGGED	3
+#define STATS_BATCHES		4       /* accel batches handled */
+#define STATS_RAISES		5       /* raises that lit the light */
+#define STATS_SHORT		6       /* raises lit for under a second */
+#define STATS_COUNT		7
+#define STATS_END		0xffff
+
+/* Settings.flags */
+#define CONFIG_CHARGING		0x01    /* light on while charging */
+#define CONFIG_PLUGGED		0x02    /* light on while plugged in */
+#define CONFIG_AMBIENT		0x04    /* honour the ambient light sensor */
+#define CONFIG_TAP_WAKE		0x08    /* accel data only after a tap */
+#define CONFIG_TRACE		0x10    /* record accel traces */
+#define CONFIG_NO_SAVER		0x20    /* ignore the battery level */
+#define CONFIG_USAGE		0x40    /* usage records through data logging */
+#define CONFIG_RAW_ACCEL	0x80    /* raw accel samples, no vibe flag */
+
+/* Settings.profile: how the watch is worn, for the posture check */
+#define PROFILE_BOX		0       /* the x/y/z box, fitted by calibration */
+#define PROFILE_LEFT		1
+#define PROFILE_RIGHT		2
+#define PROFILE_LEFT_INVERTED	3       /* face on the inside of the wrist */
+#define PROFILE_RIGHT_INVERTED	4
+#define PROFILES		5
+
+/* Settings.detector: what lights the light */
+#define DETECTOR_POSTURE	0       /* holding the viewing posture */
+#define DETECTOR_RAISE		1       /* a raise into it, not just holding it */
+#define DETECTORS		2
+
+#define SETTINGS_VERSION	5
+
+typedef struct __attribute__((__packed__)) {
+    uint8_t version;
+    uint8_t duration;                   /* light on, seconds; 0 = until lowered */
+    uint8_t samples;                    /* batch, 1/10th seconds */
+    uint8_t dwell;                      /* raise delay, 1/10th seconds */
+    uint8_t flags;                      /* CONFIG_* */
+    Schedule schedule;
+    uint8_t profile;                    /* PROFILE_*, added in version 3 */
+    uint8_t detector;                   /* DETECTOR_*, added in version 4 */
+    int32_t awake_until;                /* turned on by hand: awake until
+                                           then, added in version 5 */
+} Settings;
+
+/* Version 1: a single start and stop time every day */
+typedef struct __attribute__((__packed__)) {
+    uint8_t version;
+    uint8_t duration;
+    uint8_t samples;
+    uint8_t dwell;
+    uint8_t flags;
+    uint8_t start_hour;
+    uint8_t start_min;
+    uint8_t stop_hour;
+    uint8_t stop_min;
+} SettingsV1;
+
+
+static inline void
+settings_default (Settings *s)
+{
+
+    memset(s, 0, sizeof(*s));
+    s->version = SETTINGS_VERSION;
+    s->duration = 5;
+    s->samples = 1;
+    s->dwell = 5;
+    schedule_clear(&s->schedule);
+}
+
+
+/*
+ * Build a record from the pre-record keys, with the same defaults the
+ * app used for missing ones.
+ */
+static inline void
+settings_from_legacy (Settings *s)
+{
+
+    settings_default(s);
+    schedule_daily(&s->schedule,
+                   persist_read_int(START_HOUR), persist_read_int(START_MINUTE),
+                   persist_read_int(STOP_HOUR), persist_read_int(STOP_MINUTE));
+    if (persist_exists(DURATION))
+        s->duration = persist_read_int(DURATION);
+    if (persist_read_int(SAMPLES))
+        s->samples = persist_read_int(SAMPLES);
+    if (persist_exists(DWELL))
+        s->dwell = persist_read_int(DWELL);
+    s->flags = (persist_read_bool(CHARGING) ? CONFIG_CHARGING : 0) |
+        (persist_read_bool(PLUGGED) ? CONFIG_PLUGGED : 0) |
+        (persist_read_bool(AMBIENT) ? CONFIG_AMBIENT : 0) |
+        (persist_read_bool(TAP_WAKE) ? CONFIG_TAP_WAKE : 0) |
+        (persist_read_bool(TRACE) ? CONFIG_TRACE : 0);
+}
+
+
+/*
+ * Read the settings record.  Returns false if it was missing or an older
+ * version and the settings had to be converted, which the caller may then
+ * migrate with settings_save() and settings_delete_legacy().
+ */
+static inline bool
+settings_load (Settings *s)
+{
+    SettingsV1 old;
+    int n;
+
+    n = persist_read_data(SETTINGS_KEY, s, sizeof(*s));
+    if (n == (int)sizeof(*s) && s->version == SETTINGS_VERSION)
+        return(true);
+
+    /* versions 2 to 4 are this record without the fields added since */
+    if (n == (int)(sizeof(*s) - sizeof(s->profile) - sizeof(s->detector) -
+                   sizeof(s->awake_until)) && s->version == 2) {
+        s->version = SETTINGS_VERSION;
+        s->profile = PROFILE_BOX;
+        s->detector = DETECTOR_POSTURE;
+        s->awake_until = 0;
+        return(false);
+    }
+    if (n == (int)(sizeof(*s) - sizeof(s->detector) - sizeof(s->awake_until)) &&
+        s->version == 3) {
+        s->version = SETTINGS_VERSION;
+        s->detector = DETECTOR_POSTURE;
+        s->awake_until = 0;
+        return(false);
+    }
+    if (n == (int)(sizeof(*s) - sizeof(s->awake_until)) && s->version == 4) {
+        s->version = SETTINGS_VERSION;
+        s->awake_until = 0;
+        return(false);
+    }
+
+    if (n == (int)sizeof(old) && s->version == 1) {
+        memcpy(&old, s, sizeof(old));
+        settings_default(s);
+        s->duration = old.duration;
+        s->samples = old.samples;
+        s->dwell = old.dwell;
+        s->flags = old.flags;
+        schedule_daily(&s->schedule, old.start_hour, old.start_min,
+                       old.stop_hour, old.stop_min);
+        return(false);
+    }
+
+    settings_from_legacy(s);
+    return(false);
+}
+
+
+static inline void
+settings_save (const Settings *s)
+{
+
+    persist_write_data(SETTINGS_KEY, s, sizeof(*s));
+}
+
+
+static inline void
+settings_delete_legacy (void)
+{
+    static const uint8_t keys[] = {
+        START_HOUR, START_MINUTE, STOP_HOUR, STOP_MINUTE, DURATION,
+        SAMPLES, CHARGING, PLUGGED, AMBIENT, TRACE, TAP_WAKE, DWELL,
+        AWAKE_UNTIL,
+    };
+    uint8_t i;
+
+    for (i = 0 ; i < sizeof(keys) ; i++) {
+        persist_delete(keys[i]);
+    }
+}
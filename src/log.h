@@ -0,0 +1,41 @@
+/*
+ * Logging shared by the app and the worker.
+ *
+ * LOG() calls below LOG_LEVEL compile to nothing, format string
+ * included, so chatty state-change logging costs no flash or time in
+ * normal builds.  Pick the level at build time, e.g.
+ *
+ *	BACKLIGHT_LOG_LEVEL=DEBUG pebble build
+ *
+ * Lower numbers are more severe, as with AppLogLevel.
+ */
+#pragma once
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL APP_LOG_LEVEL_WARNING
+#endif
+
+#define LOG(level, fmt, args...)                        \
+    do {                                                \
+        if ((level) <= LOG_LEVEL)                       \
+            APP_LOG(level, fmt, ## args);               \
+    } while (0)
+
+/*
+ * Worker event log entries, kept in a binary ring by the worker and sent
+ * to the app on request as (code, arg, seconds) worker messages.
+ */
+#define EVLOG_LIGHT_ON		1
+#define EVLOG_LIGHT_OFF		2
+#define EVLOG_CHARGING		3
+#define EVLOG_PLUGGED		4
+#define EVLOG_UNPLUGGED		5
+#define EVLOG_RATE		6       /* arg: governor state */
+#define EVLOG_START		7
+#define EVLOG_TIMEOUT		8       /* light-off timer fired */
+#define EVLOG_SLEEP		9       /* outside the schedule */
+#define EVLOG_WAKE		10      /* back inside the schedule */
+#define EVLOG_CAL_RAISE		11      /* arg: raises captured so far */
+#define EVLOG_CALIBRATED	12      /* arg: raises used, 0 = gave up */
+#define EVLOG_POLICY		13      /* arg: battery policy row's level, 0 = none */
+#define EVLOG_END		0xffff  /* last entry of a dump */
@@ -0,0 +1,216 @@
+/*
+ * Weekly backlight schedule.
+ *
+ * Each day of the week uses one of two profiles, weekday or weekend,
+ * and a profile holds up to SCHED_WINDOWS on/off windows given as
+ * minutes since local midnight.  A window whose stop is before its start
+ * runs over midnight into the next day; start == stop marks it unused.
+ *
+ * schedule_compile() flattens the week into a sorted table of edges
+ * (minutes since Sunday 00:00, tagged with the state entered), merging
+ * overlapping windows so that edges always alternate.  day_first[] indexes
+ * the table by day, so finding the next edge only looks at one day's few
+ * entries, whatever the time.
+ *
+ * Edges are turned back into timestamps with clock_to_timestamp(), which
+ * works in local wall-clock time, so a 07:00 edge stays at 07:00 across
+ * a DST change.  An edge in the hour skipped by DST falls at the jump.
+ *
+ * Include after pebble.h or pebble_worker.h.
+ */
+#pragma once
+
+#define SCHED_WINDOWS		3       /* per profile */
+#define SCHED_WEEKDAY		0
+#define SCHED_WEEKEND		1
+#define SCHED_PROFILES		2
+#define SCHED_DAY		(24 * 60)
+#define SCHED_WEEK		(7 * SCHED_DAY)
+#define SCHED_EDGE_ON		0x8000  /* edge turns the light on */
+#define SCHED_EDGES		(7 * SCHED_WINDOWS * 2)
+
+typedef struct __attribute__((__packed__)) {
+    uint16_t start;                     /* minutes since midnight */
+    uint16_t stop;
+} SchedWindow;
+
+typedef struct __attribute__((__packed__)) {
+    uint8_t weekend;                    /* bit per tm_wday using SCHED_WEEKEND */
+    SchedWindow win[SCHED_PROFILES][SCHED_WINDOWS];
+} Schedule;
+
+typedef struct {
+    uint8_t count;
+    bool always;                        /* state when there are no edges */
+    uint8_t day_first[8];               /* first edge of each day, [7] = count */
+    uint16_t edge[SCHED_EDGES];         /* minute of week | SCHED_EDGE_ON */
+} SchedTable;
+
+
+static inline void
+schedule_clear (Schedule *s)
+{
+
+    memset(s, 0, sizeof(*s));
+    s->weekend = (1 << 0) | (1 << 6);   /* Sunday, Saturday */
+}
+
+
+/*
+ * One window every day, the way start and stop times used to work
+ */
+static inline void
+schedule_daily (Schedule *s, int start_hour, int start_min,
+                int stop_hour, int stop_min)
+{
+    int p;
+
+    schedule_clear(s);
+    for (p = 0 ; p < SCHED_PROFILES ; p++) {
+        s->win[p][0].start = start_hour * 60 + start_min;
+        s->win[p][0].stop = stop_hour * 60 + stop_min;
+    }
+}
+
+
+static inline bool
+schedule_empty (const Schedule *s)
+{
+    int p, w;
+
+    for (p = 0 ; p < SCHED_PROFILES ; p++) {
+        for (w = 0 ; w < SCHED_WINDOWS ; w++) {
+            if (s->win[p][w].start != s->win[p][w].stop)
+                return(false);
+        }
+    }
+    return(true);
+}
+
+
+static inline void
+schedule_compile (const Schedule *s, SchedTable *t)
+{
+    uint16_t ev[SCHED_EDGES];           /* minute << 1 | ends */
+    uint16_t v;
+    int n = 0, active = 0, was;
+    int d, w, i, j, len;
+    const SchedWindow *win;
+
+    for (d = 0 ; d < 7 ; d++) {
+        win = s->win[(s->weekend >> d) & 1 ? SCHED_WEEKEND : SCHED_WEEKDAY];
+        for (w = 0 ; w < SCHED_WINDOWS ; w++) {
+            if (win[w].start == win[w].stop)
+                continue;
+            len = win[w].stop - win[w].start;
+            if (len < 0)
+                len += SCHED_DAY;
+            i = d * SCHED_DAY + win[w].start;
+            if (i + len >= SCHED_WEEK)
+                active++;               /* covers the end of the week */
+            ev[n++] = (uint16_t)(i << 1);
+            ev[n++] = (uint16_t)((((i + len) % SCHED_WEEK) << 1) | 1);
+        }
+    }
+
+    /* insertion sort: at most a few dozen entries */
+    for (i = 1 ; i < n ; i++) {
+        v = ev[i];
+        for (j = i ; j > 0 && ev[j - 1] > v ; j--) {
+            ev[j] = ev[j - 1];
+        }
+        ev[j] = v;
+    }
+
+    t->always = active > 0;
+    t->count = 0;
+    for (i = 0 ; i < n ; i = j) {
+        was = active;
+        for (j = i ; j < n && (ev[j] >> 1) == (ev[i] >> 1) ; j++) {
+            active += (ev[j] & 1) ? -1 : 1;
+        }
+        if ((was > 0) != (active > 0))
+            t->edge[t->count++] = (ev[i] >> 1) | (active > 0 ? SCHED_EDGE_ON : 0);
+    }
+
+    for (d = 0, i = 0 ; d < 7 ; d++) {
+        while (i < t->count && (t->edge[i] & ~SCHED_EDGE_ON) < d * SCHED_DAY)
+            i++;
+        t->day_first[d] = i;
+    }
+    t->day_first[7] = t->count;
+}
+
+
+/*
+ * Index of the first edge after minute of week m, wrapping round to the
+ * start of the week, or -1 if the state never changes.
+ */
+static inline int
+schedule_next (const SchedTable *t, int m)
+{
+    int i;
+
+    if (t->count == 0)
+        return(-1);
+
+    for (i = t->day_first[m / SCHED_DAY] ; i < t->count ; i++) {
+        if ((t->edge[i] & ~SCHED_EDGE_ON) > m)
+            return(i);
+    }
+    return(0);
+}
+
+
+static inline int
+schedule_minute (time_t when)
+{
+    struct tm *tm = localtime(&when);
+
+    return(tm->tm_wday * SCHED_DAY + tm->tm_hour * 60 + tm->tm_min);
+}
+
+
+static inline bool
+schedule_active (const SchedTable *t, time_t when)
+{
+    int i = schedule_next(t, schedule_minute(when));
+
+    if (i < 0)
+        return(t->always);
+    /* the edge before the next one set the current state */
+    return((t->edge[i] & SCHED_EDGE_ON) == 0);
+}
+
+
+/*
+ * When the light next turns on (or off), or 0 if it never does.
+ */
+static inline time_t
+schedule_next_time (const SchedTable *t, time_t now, bool on)
+{
+    int i = schedule_next(t, schedule_minute(now));
+    int m, d;
+    time_t when;
+
+    if (i < 0)
+        return(0);
+    if (((t->edge[i] & SCHED_EDGE_ON) != 0) != on)
+        i = (i + 1) % t->count;         /* edges alternate */
+
+    m = t->edge[i] & ~SCHED_EDGE_ON;
+    when = clock_to_timestamp((WeekDay)(SUNDAY + m / SCHED_DAY),
+                              (m % SCHED_DAY) / 60, m % 60);
+
+    /*
+     * An edge in the hour skipped when DST starts is pushed past the gap;
+     * it belongs where the clock jumps over it.
+     */
+    for (;;) {
+        d = schedule_minute(when - 60) % SCHED_DAY - m % SCHED_DAY;
+        if (d < 0 || d >= 120)
+            break;
+        when -= 60;
+    }
+    return(when);
+}
@@ -0,0 +1,727 @@
+/*
+ * Host-side replay of accelerometer traces through the backlight worker.
+ *
+ * The worker (worker_src/backlight_worker.c) is compiled unchanged against
+ * tools/stub/pebble_worker.h, its main() is run to pick up settings from
+ * the fake persist store, and then the samples of a trace are fed to
+ * whatever AccelDataHandler or AccelRawDataHandler it subscribed, batched
+ * the way the real accel service would batch them.
+ *
+ * Traces are either binary files written by the worker's recorder (format
+ * in worker_src/trace.h), a captured log holding the recorder's "TRC"
+ * hex dump lines, or text, one record per line:
+ *
+ *	# comment
+ *	R <start_ms> <end_ms>		a deliberate raise; light should come on
+ *	<t_ms> <x> <y> <z> [vib]	one sample, timestamps ascending
+ *
+ * Traces should be recorded at the highest rate the worker may ask for;
+ * samples are decimated down to the worker's current sampling rate.
+ *
+ * Reported: light-on latency for each raise, false triggers (light on
+ * outside every raise window), missed raises and CPU time per sample.
+ */
+#include <stdlib.h>
+#include <getopt.h>
+#include "stub/pebble_worker.h"
+#include "../worker_src/trace.h"
+#include "../worker_src/detector.h"
+#include "../worker_src/filter.h"
+#include "../worker_src/usage.h"
+#include "../src/log.h"
+#include "../src/config.h"
+
+#undef time
+
+/* From backlight_worker.c, renamed by the Makefile */
+int worker_main(void);
+
+#define MAX_RAISES	256
+#define TAP_DELTA	400             /* mg jump between samples to start a tap */
+#define TAP_REST	150             /* mg from where it started to end one */
+#define TAP_MS		100             /* longest a tap lasts */
+#define MAX_BATCH	100
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t lit_at;                    /* 0 = never lit */
+} Raise;
+
+static Raise raises[MAX_RAISES];
+static int num_raises;
+
+static AccelData *trace;
+static size_t trace_len;
+static size_t trace_alloc;
+
+static int recorded_ons;                /* light-on events in a binary trace */
+static int light_ons;
+static int false_triggers;
+static uint64_t lit_since;
+static uint64_t lit_total_ms;
+static bool lit;
+
+
+/****************************************************************************
+ * Trace loading
+ ****************************************************************************/
+
+static void
+trace_append (uint64_t t, int x, int y, int z, bool vib)
+{
+    if (trace_len == trace_alloc) {
+        trace_alloc = trace_alloc ? trace_alloc * 2 : 4096;
+        trace = realloc(trace, trace_alloc * sizeof(*trace));
+        if (!trace) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    trace[trace_len].x = (int16_t)x;
+    trace[trace_len].y = (int16_t)y;
+    trace[trace_len].z = (int16_t)z;
+    trace[trace_len].did_vibrate = vib;
+    trace[trace_len].timestamp = t;
+    trace_len++;
+}
+
+static int
+get16 (const uint8_t *p)
+{
+    return((int16_t)(p[0] | (p[1] << 8)));
+}
+
+static uint32_t
+get32 (const uint8_t *p)
+{
+    return(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static int
+sext5 (int v)
+{
+    return((v & 0x10) ? v - 32 : v);
+}
+
+/*
+ * Decode a recorder file; see worker_src/trace.h for the layout.
+ * Timestamps come out relative to the file's base time.
+ */
+static bool
+load_binary_trace (const uint8_t *buf, size_t len)
+{
+    size_t block_size, blocks, b, off, end;
+    uint32_t period;
+    uint64_t t = 0;
+    int x = 0, y = 0, z = 0;
+    uint8_t tag;
+
+    if (len < TRACE_HEADER_SIZE || memcmp(buf, "BLTR", 4) != 0 ||
+        buf[4] != TRACE_VERSION || buf[5] == 0) {
+        fprintf(stderr, "not a version %d trace\n", TRACE_VERSION);
+        return(false);
+    }
+    period = 1000 / buf[5];
+    block_size = buf[6] | (buf[7] << 8);
+    blocks = buf[8] | (buf[9] << 8);
+    if (TRACE_HEADER_SIZE + block_size * blocks > len) {
+        fprintf(stderr, "trace truncated\n");
+        return(false);
+    }
+
+    for (b = 0 ; b < blocks ; b++) {
+        off = TRACE_HEADER_SIZE + b * block_size;
+        end = off + block_size;
+        while (off < end) {
+            tag = buf[off];
+            if (tag == 0xFF) {
+                break;
+            } else if ((tag & 0x80) == 0) {
+                if (off + 2 > end) break;
+                x += sext5((tag >> 2) & 0x1f);
+                y += sext5(((tag & 3) << 3) | (buf[off + 1] >> 5));
+                z += sext5(buf[off + 1] & 0x1f);
+                trace_append(t, x, y, z, false);
+                t += period;
+                off += 2;
+            } else if ((tag & 0xFE) == 0x80) {
+                if (off + 4 > end) break;
+                x += (int8_t)buf[off + 1];
+                y += (int8_t)buf[off + 2];
+                z += (int8_t)buf[off + 3];
+                trace_append(t, x, y, z, tag & 1);
+                t += period;
+                off += 4;
+            } else if ((tag & 0xFE) == 0xA0) {
+                if (off + 7 > end) break;
+                x = get16(&buf[off + 1]);
+                y = get16(&buf[off + 3]);
+                z = get16(&buf[off + 5]);
+                trace_append(t, x, y, z, tag & 1);
+                t += period;
+                off += 7;
+            } else if ((tag & 0xE0) == 0xC0) {
+                if ((tag & 0x1f) == TRACE_EVENT_LIGHT_ON)
+                    recorded_ons++;
+                off += 1;
+            } else if (tag == 0xE0) {
+                if (off + 5 > end) break;
+                t = get32(&buf[off + 1]);
+                off += 5;
+            } else {
+                fprintf(stderr, "bad record 0x%02x at %zu\n", tag, off);
+                return(false);
+            }
+        }
+    }
+    return(true);
+}
+
+/*
+ * Pull "TRC <offset> <hex>" lines out of a captured log and decode them
+ */
+static bool
+load_log_trace (FILE *f)
+{
+    static uint8_t buf[TRACE_HEADER_SIZE + TRACE_BLOCKS * TRACE_BLOCK_SIZE];
+    char line[512], *p;
+    unsigned int offset, v;
+    size_t len = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        p = strstr(line, "TRC ");
+        if (!p || sscanf(p + 4, "%x", &offset) != 1)
+            continue;
+        if (offset != len) {
+            fprintf(stderr, "log gap at offset 0x%x\n", (uint)len);
+            return(false);
+        }
+        p = strchr(p + 4, ' ');
+        if (!p)
+            continue;
+        for (p++ ; len < sizeof(buf) && sscanf(p, "%2x", &v) == 1 ; p += 2)
+            buf[len++] = (uint8_t)v;
+    }
+    return(load_binary_trace(buf, len));
+}
+
+static void
+load_text_trace (FILE *f)
+{
+    char line[256];
+    unsigned long long t, e;
+    int x, y, z, vib;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (line[0] == 'R') {
+            if (sscanf(line + 1, "%llu %llu", &t, &e) == 2 &&
+                num_raises < MAX_RAISES) {
+                raises[num_raises].start = t;
+                raises[num_raises].end = e;
+                num_raises++;
+            }
+            continue;
+        }
+        vib = 0;
+        if (sscanf(line, "%llu %d %d %d %d", &t, &x, &y, &z, &vib) >= 4)
+            trace_append(t, x, y, z, vib != 0);
+    }
+}
+
+
+/*
+ * A tap is a sharp spike that is gone again within TAP_MS: a jump of
+ * over TAP_DELTA from one sample to the next, then back to within
+ * TAP_REST of where it started.  A raise moves as far, but smoothly, and
+ * stays there.
+ */
+static int
+sample_distance (const AccelData *a, const AccelData *b)
+{
+    return(abs(a->x - b->x) + abs(a->y - b->y) + abs(a->z - b->z));
+}
+
+static bool
+is_tap (size_t i)
+{
+    size_t j;
+
+    if (i == 0 || sample_distance(&trace[i], &trace[i - 1]) <= TAP_DELTA)
+        return(false);
+    for (j = i + 1 ; j < trace_len &&
+             trace[j].timestamp - trace[i - 1].timestamp <= TAP_MS ; j++) {
+        if (sample_distance(&trace[j], &trace[i - 1]) < TAP_REST)
+            return(true);
+    }
+    return(false);
+}
+
+
+/****************************************************************************
+ * Synthetic corpus
+ ****************************************************************************/
+
+static uint32_t synth_seed = 1;
+
+static int
+synth_noise (int amplitude)
+{
+    synth_seed = synth_seed * 1103515245 + 12345;
+    return((int)((synth_seed >> 16) % (2 * amplitude + 1)) - amplitude);
+}
+
+static uint64_t synth_t;
+
+/* Hold or ramp from (x0,y0,z0) to (x1,y1,z1) over ms at 50Hz */
+static void
+synth_segment (FILE *f, int ms, int x0, int y0, int z0,
+               int x1, int y1, int z1, int noise)
+{
+    int i, n = ms / 20;
+
+    for (i = 0 ; i < n ; i++) {
+        fprintf(f, "%llu %d %d %d\n", (unsigned long long)synth_t,
+                x0 + (x1 - x0) * i / n + synth_noise(noise),
+                y0 + (y1 - y0) * i / n + synth_noise(noise),
+                z0 + (z1 - z0) * i / n + synth_noise(noise));
+        synth_t += 20;
+    }
+}
+
+#define SIDE	-950, -50, -250         /* arm hanging at the side */
+#define VIEW	0, -650, -750           /* looking at the watch */
+#define DESK	80, -120, -990          /* hands on a keyboard */
+#define BED	-100, -700, -700        /* holding still, face toward you */
+
+static void
+synth_raise (FILE *f, int hold_ms)
+{
+    fprintf(f, "R %llu %llu\n", (unsigned long long)synth_t,
+            (unsigned long long)(synth_t + 400 + hold_ms));
+    synth_segment(f, 400, SIDE, VIEW, 40);
+    synth_segment(f, hold_ms, VIEW, VIEW, 30);
+    synth_segment(f, 400, VIEW, SIDE, 40);
+}
+
+/*
+ * A raise held on a bumpy ride: every 600ms a 40ms jolt throws x out of
+ * the viewing posture
+ */
+static void
+synth_bumpy_raise (FILE *f, int hold_ms)
+{
+    int t;
+
+    fprintf(f, "R %llu %llu\n", (unsigned long long)synth_t,
+            (unsigned long long)(synth_t + 400 + hold_ms));
+    synth_segment(f, 400, SIDE, VIEW, 40);
+    for (t = 0 ; t + 600 <= hold_ms ; t += 600) {
+        synth_segment(f, 560, VIEW, VIEW, 30);
+        synth_segment(f, 40, 700, -650, -750, 700, -650, -750, 30);
+    }
+    synth_segment(f, 400, VIEW, SIDE, 40);
+}
+
+/*
+ * A raise, then a tap on the face to light it: 40ms pressed along z, as
+ * tap wake wants, tap_ms into the hold
+ */
+static void
+synth_tapped_raise (FILE *f, int tap_ms, int hold_ms)
+{
+
+    fprintf(f, "R %llu %llu\n", (unsigned long long)synth_t,
+            (unsigned long long)(synth_t + 400 + hold_ms));
+    synth_segment(f, 400, SIDE, VIEW, 40);
+    synth_segment(f, tap_ms, VIEW, VIEW, 30);
+    synth_segment(f, 40, 0, -650, -1250, 0, -650, -1250, 30);
+    synth_segment(f, hold_ms - tap_ms - 40, VIEW, VIEW, 30);
+    synth_segment(f, 400, VIEW, SIDE, 40);
+}
+
+/*
+ * A repeatable mixed scenario at 50Hz: deliberate raises of varying
+ * length interleaved with the postures that cause false wakes.
+ */
+static void
+synth_corpus (FILE *f)
+{
+    fprintf(f, "# synthetic corpus, 50Hz\n");
+    synth_segment(f, 5000, SIDE, SIDE, 8);
+    synth_raise(f, 3000);
+    synth_segment(f, 4000, SIDE, SIDE, 8);
+    synth_segment(f, 400, SIDE, DESK, 40);
+    synth_segment(f, 15000, DESK, DESK, 40);
+    synth_segment(f, 400, DESK, SIDE, 40);
+    synth_raise(f, 1500);
+    synth_segment(f, 3000, SIDE, SIDE, 8);
+    synth_raise(f, 700);
+    synth_segment(f, 3000, SIDE, SIDE, 8);
+    synth_segment(f, 1500, SIDE, BED, 40);
+    synth_segment(f, 20000, BED, BED, 8);
+    synth_segment(f, 1500, BED, SIDE, 40);
+    synth_segment(f, 3000, SIDE, SIDE, 8);
+    synth_raise(f, 5000);
+    synth_segment(f, 5000, SIDE, SIDE, 8);
+    synth_bumpy_raise(f, 6000);
+    synth_segment(f, 5000, SIDE, SIDE, 8);
+    synth_tapped_raise(f, 1000, 4000);
+    synth_segment(f, 5000, SIDE, SIDE, 8);
+}
+
+
+/****************************************************************************
+ * Replay
+ ****************************************************************************/
+
+static void
+light_hook (uint64_t now, bool on)
+{
+    int i;
+
+    if (on) {
+        light_ons++;
+        lit = true;
+        lit_since = now;
+        for (i = 0 ; i < num_raises ; i++) {
+            if (now >= raises[i].start && now <= raises[i].end) {
+                if (raises[i].lit_at == 0)
+                    raises[i].lit_at = now;
+                return;
+            }
+        }
+        false_triggers++;
+    } else if (lit) {
+        lit = false;
+        lit_total_ms += now - lit_since;
+    }
+}
+
+static bool
+load_trace (const char *path)
+{
+    FILE *f;
+    char magic[4];
+    char line[256];
+    bool ok = true;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return(false);
+    }
+    if (fread(magic, 1, 4, f) == 4 && memcmp(magic, "BLTR", 4) == 0) {
+        uint8_t *buf = NULL;
+        size_t len = 0, n;
+
+        rewind(f);
+        do {
+            buf = realloc(buf, len + 4096);
+            n = fread(buf + len, 1, 4096, f);
+            len += n;
+        } while (n > 0);
+        ok = load_binary_trace(buf, len);
+        free(buf);
+    } else {
+        rewind(f);
+        while (fgets(line, sizeof(line), f) && !strstr(line, "TRC "))
+            ;
+        rewind(f);
+        if (strstr(line, "TRC "))
+            ok = load_log_trace(f);
+        else
+            load_text_trace(f);
+    }
+    fclose(f);
+    return(ok);
+}
+
+static void
+export_emit (const uint8_t *data, size_t len, void *context)
+{
+    fwrite(data, 1, len, (FILE *)context);
+}
+
+static void
+evlog_print (uint8_t type, AppWorkerMessage *data)
+{
+    if (type == WORKER_DUMP_LOG && data->data0 != EVLOG_END)
+        fprintf(stderr, "evlog %5u code %u arg %u\n",
+                data->data2 | (uint32_t)(data->data1 >> 8) << 16,
+                data->data0, data->data1 & 0xff);
+}
+
+static uint32_t worker_stats[STATS_COUNT];
+
+static void
+stats_collect (uint8_t type, AppWorkerMessage *data)
+{
+    if (type == WORKER_STATS && data->data0 < STATS_COUNT)
+        worker_stats[data->data0] = data->data1 | ((uint32_t)data->data2 << 16);
+}
+
+static double
+elapsed_ns (struct timespec *a, struct timespec *b)
+{
+    return((b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec));
+}
+
+static void
+usage (const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-d duration] [-s samples] [-w dwell] [-a] [-t] [-v] [-r out]\n"
+            "       %*s [-S hh:mm-hh:mm] [-c] [-b percent] [-u out] [-p profile] [-R]\n"
+            "       %*s [-F median,tau_ms] [-m]\n"
+            "       %*s trace-file\n"
+            "       %s -g > corpus.txt\n"
+            "  -d  light duration in seconds (default 5)\n"
+            "  -s  samples per accel batch (default 1)\n"
+            "  -w  raise delay in 1/10th seconds (default 5)\n"
+            "  -a  use the ambient-light aware light API\n"
+            "  -t  tap wake mode: accel data only after a tap\n"
+            "  -v  show worker log output\n"
+            "  -r  run the worker's trace recorder and write its file to out\n"
+            "  -S  daily schedule window, in local time; the trace\n"
+            "      starts at %s"
+            "  -c  calibrate on the trace's raises and print the box\n"
+            "  -b  battery charge percent (default 100)\n"
+            "  -u  log usage records and write them to out\n"
+            "  -p  wrist profile, PROFILE_* (default 0, the box)\n"
+            "  -R  raw accel samples (CONFIG_RAW_ACCEL)\n"
+            "  -m  light only on a raise into the posture (DETECTOR_RAISE)\n"
+            "  -F  pre-filter: median of 1, 3 or 5 samples, then a low-pass\n"
+            "      with the given time constant, 0 = none (default %d,%d)\n"
+            "  -g  write the synthetic corpus to stdout\n",
+            prog, (int)strlen(prog), "", (int)strlen(prog), "",
+            (int)strlen(prog), "", prog, ctime(&(time_t){ STUB_EPOCH }),
+            FILTER_MEDIAN, FILTER_TAU_MS);
+    exit(2);
+}
+
+int
+main (int argc, char **argv)
+{
+    AccelData batch[MAX_BATCH];
+    AccelRawData raw_batch[MAX_BATCH];
+    uint64_t raw_ts = 0;
+    uint32_t n = 0;
+    uint64_t next_due = 0;
+    uint64_t delivered = 0, batches = 0;
+    uint64_t off_ms = 0, slow_ms = 0, fast_ms = 0;
+    int taps = 0;
+    double cpu_ns = 0;
+    struct timespec t0, t1;
+    int duration = 5, nsamples = 1, ambient = 0, tap_wake = 0, dwell = 5;
+    int sh = 0, sm = 0, eh = 0, em = 0;
+    int calibrate = 0, profile = PROFILE_BOX, raw = 0, raise = 0;
+    int median = FILTER_MEDIAN, tau = FILTER_TAU_MS;
+    bool on;
+    const char *record = NULL, *usage_out = NULL;
+    Settings settings;
+    int detected = 0;
+    uint64_t lat_sum = 0, lat_min = UINT64_MAX, lat_max = 0;
+    size_t i;
+    int c;
+
+    while ((c = getopt(argc, argv, "d:s:w:atvr:S:cb:u:p:RF:mg")) != -1) {
+        switch (c) {
+        case 'd': duration = atoi(optarg); break;
+        case 's': nsamples = atoi(optarg); break;
+        case 'w': dwell = atoi(optarg); break;
+        case 'a': ambient = 1; break;
+        case 't': tap_wake = 1; break;
+        case 'v': stub_log_enabled = true; break;
+        case 'r': record = optarg; break;
+        case 'S':
+            if (sscanf(optarg, "%d:%d-%d:%d", &sh, &sm, &eh, &em) != 4)
+                usage(argv[0]);
+            break;
+        case 'c': calibrate = 1; break;
+        case 'b': stub_battery.charge_percent = atoi(optarg); break;
+        case 'u': usage_out = optarg; break;
+        case 'p': profile = atoi(optarg); break;
+        case 'R': raw = 1; break;
+        case 'm': raise = 1; break;
+        case 'F':
+            if (sscanf(optarg, "%d,%d", &median, &tau) != 2)
+                usage(argv[0]);
+            break;
+        case 'g': synth_corpus(stdout); return(0);
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+        usage(argv[0]);
+
+    if (!load_trace(argv[optind]))
+        return(1);
+    if (trace_len == 0) {
+        fprintf(stderr, "%s: no samples\n", argv[optind]);
+        return(1);
+    }
+
+    stub_reset();
+    stub_now_ms = trace[0].timestamp;
+    settings_default(&settings);
+    settings.duration = duration;
+    settings.samples = nsamples;
+    settings.dwell = dwell;
+    settings.flags = (ambient ? CONFIG_AMBIENT : 0) |
+        (tap_wake ? CONFIG_TAP_WAKE : 0) |
+        (record ? CONFIG_TRACE : 0) |
+        (usage_out ? CONFIG_USAGE : 0) |
+        (raw ? CONFIG_RAW_ACCEL : 0);
+    schedule_daily(&settings.schedule, sh, sm, eh, em);
+    settings.profile = profile;
+    settings.detector = raise ? DETECTOR_RAISE : DETECTOR_POSTURE;
+    settings_save(&settings);
+    stub_light_hook = light_hook;
+    if (usage_out) {
+        stub_datalog_out = fopen(usage_out, "wb");
+        if (!stub_datalog_out) {
+            perror(usage_out);
+            return(1);
+        }
+    }
+    worker_main();
+    filter_configure(median, tau);
+    if (calibrate) {
+        AppWorkerMessage msg = { 0 };
+
+        stub_message_handler(WORKER_CALIBRATE, &msg);
+    }
+
+    for (i = 0 ; i < trace_len ; i++) {
+        stub_advance(trace[i].timestamp);
+        on = stub_accel_handler || stub_accel_raw_handler;
+        if (i > 0) {
+            uint64_t dt = trace[i].timestamp - trace[i - 1].timestamp;
+
+            if (!on)
+                off_ms += dt;
+            else if (stub_accel_rate <= ACCEL_SAMPLING_10HZ)
+                slow_ms += dt;
+            else
+                fast_ms += dt;
+        }
+        if (!on) {
+            n = 0;
+            if (stub_tap_handler && is_tap(i)) {
+                taps++;
+                stub_tap_handler(ACCEL_AXIS_X, 1);
+            }
+            continue;
+        }
+        if (trace[i].timestamp < next_due)
+            continue;
+        next_due = trace[i].timestamp + 1000 / stub_accel_rate;
+
+        if (stub_accel_raw_handler) {
+            /* one timestamp for the batch, its first sample's */
+            if (n == 0)
+                raw_ts = trace[i].timestamp + (uint64_t)STUB_EPOCH * 1000;
+            raw_batch[n++] = (AccelRawData){ trace[i].x, trace[i].y, trace[i].z };
+        } else {
+            batch[n] = trace[i];
+            batch[n++].timestamp += (uint64_t)STUB_EPOCH * 1000;
+        }
+        if (n >= stub_accel_samples || n == MAX_BATCH) {
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            if (stub_accel_raw_handler) {
+                stub_accel_raw_handler(raw_batch, n, raw_ts);
+            } else {
+                stub_accel_handler(batch, n);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            cpu_ns += elapsed_ns(&t0, &t1);
+            delivered += n;
+            batches++;
+            n = 0;
+        }
+    }
+    stub_advance(trace[trace_len - 1].timestamp + 60 * 1000);
+    if (lit)
+        light_hook(stub_now_ms, false);
+    if (usage_out) {
+        usage_flush();
+        fclose(stub_datalog_out);
+        stub_datalog_out = NULL;
+    }
+
+    if (stub_message_handler) {
+        AppWorkerMessage msg = { 0 };
+
+        stub_app_message_hook = stats_collect;
+        stub_message_handler(WORKER_STATS, &msg);
+        if (stub_log_enabled) {
+            stub_app_message_hook = evlog_print;
+            stub_message_handler(WORKER_DUMP_LOG, &msg);
+        }
+    }
+
+    if (record) {
+        FILE *out = fopen(record, "wb");
+
+        if (!out) {
+            perror(record);
+            return(1);
+        }
+        trace_export(export_emit, out);
+        fclose(out);
+    }
+
+    for (c = 0 ; c < num_raises ; c++) {
+        if (raises[c].lit_at) {
+            uint64_t lat = raises[c].lit_at - raises[c].start;
+
+            detected++;
+            lat_sum += lat;
+            if (lat < lat_min) lat_min = lat;
+            if (lat > lat_max) lat_max = lat;
+        }
+    }
+
+    printf("trace:           %s\n", argv[optind]);
+    printf("samples:         %zu in, %llu delivered in %llu batches\n",
+           trace_len, (unsigned long long)delivered,
+           (unsigned long long)batches);
+    printf("sampling s:      %llu at 10Hz, %llu faster, %llu off (%d taps)\n",
+           (unsigned long long)slow_ms / 1000,
+           (unsigned long long)fast_ms / 1000,
+           (unsigned long long)off_ms / 1000, taps);
+    printf("light-on events: %d\n", light_ons);
+    if (recorded_ons)
+        printf("recorded ons:    %d\n", recorded_ons);
+    printf("raises:          %d detected, %d missed\n",
+           detected, num_raises - detected);
+    printf("false triggers:  %d\n", false_triggers);
+    if (detected)
+        printf("latency ms:      min %llu avg %llu max %llu\n",
+               (unsigned long long)lat_min,
+               (unsigned long long)(lat_sum / detected),
+               (unsigned long long)lat_max);
+    printf("light on ms:     %llu\n", (unsigned long long)lit_total_ms);
+    printf("cpu ns/sample:   %.1f\n", delivered ? cpu_ns / delivered : 0.0);
+    printf("worker stats:    %u batches, %u raises, %u short, lit %u ms\n",
+           worker_stats[STATS_BATCHES], worker_stats[STATS_RAISES],
+           worker_stats[STATS_SHORT], worker_stats[STATS_ON_RAISE]);
+    if (usage_out)
+        printf("usage records:   %u in %u data_logging_log calls\n",
+               stub_datalog_items, stub_datalog_calls);
+    if (calibrate) {
+        Box b;
+
+        if (persist_read_data(CALIBRATION_KEY, &b, sizeof(b)) == (int)sizeof(b))
+            printf("calibrated box:  x %d..%d y %d..%d z %d..%d\n",
+                   b.low[0], b.high[0], b.low[1], b.high[1],
+                   b.low[2], b.high[2]);
+        else
+            printf("calibrated box:  none\n");
+    }
+
+    return(0);
+}
@@ -0,0 +1,239 @@
+/*
+ * Minimal host-side stand-in for the Pebble SDK's pebble.h.
+ *
+ * Only the parts of the app API used by src/backlight.c are provided.
+ * The UI calls do nothing beyond keeping enough state for the app to
+ * run; wakeups, the worker and the launch reason are simulated by
+ * stub_app.c and driven by tools/wakesim.
+ */
+#ifndef STUB_PEBBLE_H
+#define STUB_PEBBLE_H
+
+#include "stub_common.h"
+
+#define PBL_RECT
+
+/* Geometry and drawing */
+typedef struct {
+    int16_t x;
+    int16_t y;
+} GPoint;
+
+typedef struct {
+    int16_t w;
+    int16_t h;
+} GSize;
+
+typedef struct {
+    GPoint origin;
+    GSize size;
+} GRect;
+
+#define GPoint(x, y) ((GPoint){ (x), (y) })
+#define GRect(x, y, w, h) ((GRect){ { (x), (y) }, { (w), (h) } })
+
+typedef struct GContext GContext;
+typedef struct GBitmap GBitmap;
+typedef struct GFontInfo *GFont;
+
+typedef enum {
+    GTextAlignmentLeft,
+    GTextAlignmentCenter,
+    GTextAlignmentRight,
+} GTextAlignment;
+
+typedef enum {
+    GTextOverflowModeWordWrap,
+    GTextOverflowModeTrailingEllipsis,
+    GTextOverflowModeFill,
+} GTextOverflowMode;
+
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+
+GFont fonts_get_system_font(const char *font_key);
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
+
+/* Layers */
+typedef struct Layer Layer;
+typedef struct TextLayer TextLayer;
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_mark_dirty(Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+GRect layer_get_frame(const Layer *layer);
+GRect layer_get_bounds(const Layer *layer);
+
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment alignment);
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode mode);
+
+/* Windows and buttons */
+typedef struct Window Window;
+typedef void (*WindowHandler)(Window *window);
+
+typedef struct {
+    WindowHandler load;
+    WindowHandler appear;
+    WindowHandler disappear;
+    WindowHandler unload;
+} WindowHandlers;
+
+typedef enum {
+    BUTTON_ID_BACK = 0,
+    BUTTON_ID_UP,
+    BUTTON_ID_SELECT,
+    BUTTON_ID_DOWN,
+} ButtonId;
+
+typedef void *ClickRecognizerRef;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void *context);
+typedef void (*ClickConfigProvider)(void *context);
+
+Window *window_create(void);
+void window_destroy(Window *window);
+Layer *window_get_root_layer(const Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_click_config_provider(Window *window,
+                                      ClickConfigProvider click_config_provider);
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+void window_single_repeating_click_subscribe(ButtonId button_id,
+                                             uint16_t repeat_interval_ms,
+                                             ClickHandler handler);
+
+void window_stack_push(Window *window, bool animated);
+Window *window_stack_pop(bool animated);
+Window *window_stack_get_top_window(void);
+
+/* Menus */
+typedef void (*SimpleMenuLayerSelectCallback)(int index, void *context);
+
+typedef struct {
+    const char *title;
+    const char *subtitle;
+    GBitmap *icon;
+    SimpleMenuLayerSelectCallback callback;
+} SimpleMenuItem;
+
+typedef struct {
+    const char *title;
+    const SimpleMenuItem *items;
+    uint32_t num_items;
+} SimpleMenuSection;
+
+typedef struct SimpleMenuLayer SimpleMenuLayer;
+
+SimpleMenuLayer *simple_menu_layer_create(GRect frame, Window *window,
+                                          const SimpleMenuSection *sections,
+                                          int32_t num_sections,
+                                          void *callback_context);
+void simple_menu_layer_destroy(SimpleMenuLayer *menu_layer);
+Layer *simple_menu_layer_get_layer(const SimpleMenuLayer *simple_menu);
+void simple_menu_layer_set_selected_index(SimpleMenuLayer *simple_menu,
+                                          int32_t index, bool animated);
+
+typedef struct NumberWindow NumberWindow;
+typedef void (*NumberWindowCallback)(NumberWindow *number_window, void *context);
+
+typedef struct {
+    NumberWindowCallback incremented;
+    NumberWindowCallback decremented;
+    NumberWindowCallback selected;
+} NumberWindowCallbacks;
+
+NumberWindow *number_window_create(const char *label,
+                                   NumberWindowCallbacks callbacks,
+                                   void *callback_context);
+void number_window_destroy(NumberWindow *number_window);
+int32_t number_window_get_value(const NumberWindow *number_window);
+void number_window_set_value(NumberWindow *number_window, int32_t value);
+void number_window_set_max(NumberWindow *number_window, int32_t max);
+void number_window_set_min(NumberWindow *number_window, int32_t min);
+
+/* Vibration: nothing happens */
+void vibes_short_pulse(void);
+void vibes_double_pulse(void);
+
+/* Launch and wakeups */
+typedef enum {
+    APP_LAUNCH_SYSTEM = 0,
+    APP_LAUNCH_USER,
+    APP_LAUNCH_PHONE,
+    APP_LAUNCH_WAKEUP,
+    APP_LAUNCH_WORKER,
+    APP_LAUNCH_QUICK_LAUNCH,
+    APP_LAUNCH_TIMELINE_ACTION,
+    APP_LAUNCH_SMARTSTRAP,
+} AppLaunchReason;
+
+typedef int32_t WakeupId;
+
+AppLaunchReason launch_reason(void);
+WakeupId wakeup_schedule(time_t timestamp, int32_t cookie, bool notify_if_missed);
+void wakeup_cancel(WakeupId wakeup_id);
+void wakeup_cancel_all(void);
+bool wakeup_query(WakeupId wakeup_id, time_t *timestamp);
+bool wakeup_get_launch_event(WakeupId *wakeup_id, int32_t *cookie);
+
+/* The background worker */
+typedef enum {
+    APP_WORKER_RESULT_SUCCESS = 0,
+    APP_WORKER_RESULT_NO_WORKER = 1,
+    APP_WORKER_RESULT_DIFFERENT_APP = 2,
+    APP_WORKER_RESULT_NOT_RUNNING = 3,
+    APP_WORKER_RESULT_ALREADY_RUNNING = 4,
+    APP_WORKER_RESULT_ASKING_CONFIRMATION = 5,
+} AppWorkerResult;
+
+bool app_worker_is_running(void);
+AppWorkerResult app_worker_launch(void);
+AppWorkerResult app_worker_kill(void);
+AppWorkerResult app_worker_send_message(uint8_t type, AppWorkerMessage *message);
+
+/* Event loop: runs the simulator's hook, then pops every window */
+void app_event_loop(void);
+
+/*
+ * Simulator side.  The wakeup table holds every app's wakeups; ours are
+ * the ones not marked foreign.  Like the watch, it refuses a wakeup in
+ * the past (E_INVALID_ARGUMENT), within a minute of any other
+ * (E_RANGE), or past STUB_APP_WAKEUPS of our own (E_OUT_OF_RESOURCES).
+ */
+#define STUB_WAKEUPS		512     /* all apps together */
+#define STUB_APP_WAKEUPS	8
+#define STUB_WAKEUP_SPACING	60
+
+typedef struct {
+    bool used;
+    bool foreign;
+    WakeupId id;
+    time_t when;
+    int32_t cookie;
+} StubWakeup;
+
+extern StubWakeup stub_wakeups[STUB_WAKEUPS];
+extern AppLaunchReason stub_launch_reason;
+extern StubWakeup stub_launch_event;    /* wakeup behind APP_LAUNCH_WAKEUP */
+extern void (*stub_event_hook)(void);   /* run by app_event_loop() */
+extern bool stub_worker_running;
+extern bool stub_worker_declined;       /* launches ask, and the user says no */
+
+/* Counters for the simulator's report */
+extern uint32_t stub_wakeup_calls;      /* wakeup_schedule() calls */
+extern uint32_t stub_wakeup_refused;    /* ... answered E_RANGE */
+extern uint32_t stub_worker_launches;
+extern uint32_t stub_ui_created;        /* windows, layers and menus made */
+
+bool stub_wakeup_add_foreign(time_t when);
+int stub_wakeup_count(bool foreign);
+bool stub_wakeup_take_due(time_t now, StubWakeup *out);
+void stub_app_reset(void);
+
+#endif /* STUB_PEBBLE_H */
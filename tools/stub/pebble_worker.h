@@ -0,0 +1,137 @@
+/*
+ * Minimal host-side stand-in for the Pebble SDK's pebble_worker.h.
+ *
+ * Only the parts of the worker API used by worker_src/backlight_worker.c
+ * are provided.  Time is virtual: the replay tool drives the clock with
+ * stub_advance() and every time()/timer call made by the worker sees it.
+ */
+#ifndef STUB_PEBBLE_WORKER_H
+#define STUB_PEBBLE_WORKER_H
+
+#include "stub_common.h"
+
+/* Accelerometer */
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+    bool did_vibrate;
+    uint64_t timestamp;
+} AccelData;
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} AccelRawData;
+
+typedef enum {
+    ACCEL_SAMPLING_10HZ = 10,
+    ACCEL_SAMPLING_25HZ = 25,
+    ACCEL_SAMPLING_50HZ = 50,
+    ACCEL_SAMPLING_100HZ = 100,
+} AccelSamplingRate;
+
+typedef void (*AccelDataHandler)(AccelData *data, uint32_t num_samples);
+typedef void (*AccelRawDataHandler)(AccelRawData *data, uint32_t num_samples,
+                                    uint64_t timestamp);
+
+typedef enum {
+    ACCEL_AXIS_X = 0,
+    ACCEL_AXIS_Y = 1,
+    ACCEL_AXIS_Z = 2,
+} AccelAxisType;
+
+typedef void (*AccelTapHandler)(AccelAxisType axis, int32_t direction);
+
+int accel_service_set_sampling_rate(AccelSamplingRate rate);
+void accel_data_service_subscribe(uint32_t samples_per_update,
+                                  AccelDataHandler handler);
+void accel_raw_data_service_subscribe(uint32_t samples_per_update,
+                                      AccelRawDataHandler handler);
+void accel_data_service_unsubscribe(void);     /* either kind */
+void accel_tap_service_subscribe(AccelTapHandler handler);
+void accel_tap_service_unsubscribe(void);
+
+/* Battery */
+typedef struct {
+    uint8_t charge_percent;
+    bool is_charging;
+    bool is_plugged;
+} BatteryChargeState;
+
+typedef void (*BatteryStateHandler)(BatteryChargeState charge);
+
+void battery_state_service_subscribe(BatteryStateHandler handler);
+void battery_state_service_unsubscribe(void);
+BatteryChargeState battery_state_service_peek(void);
+
+/* Timers */
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback,
+                             void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+
+/* Light */
+void light_enable(bool enable);
+void light_enable_interaction(void);
+
+/* Data logging */
+typedef struct DataLoggingSession *DataLoggingSessionRef;
+
+typedef enum {
+    DATA_LOGGING_BYTE_ARRAY = 0,
+    DATA_LOGGING_UINT = 2,
+    DATA_LOGGING_INT = 3,
+} DataLoggingItemType;
+
+typedef enum {
+    DATA_LOGGING_SUCCESS = 0,
+    DATA_LOGGING_BUSY,
+    DATA_LOGGING_FULL,
+    DATA_LOGGING_NOT_FOUND,
+    DATA_LOGGING_CLOSED,
+    DATA_LOGGING_INVALID_PARAMS,
+    DATA_LOGGING_INTERNAL_ERR,
+} DataLoggingResult;
+
+DataLoggingSessionRef data_logging_create(uint32_t tag,
+                                          DataLoggingItemType item_type,
+                                          uint16_t item_length, bool resume);
+void data_logging_finish(DataLoggingSessionRef logging_session);
+DataLoggingResult data_logging_log(DataLoggingSessionRef logging_session,
+                                   const void *data, uint32_t num_items);
+
+/* Messages from the foreground app */
+void app_worker_send_message(uint8_t type, AppWorkerMessage *data);
+
+/* Event loop: returns immediately on the host */
+void worker_event_loop(void);
+
+/*
+ * Host-only hooks used by the replay tool
+ */
+typedef void (*StubLightHook)(uint64_t now_ms, bool on);
+typedef void (*StubAppMessageHook)(uint8_t type, AppWorkerMessage *data);
+
+extern AccelDataHandler stub_accel_handler;
+extern AccelRawDataHandler stub_accel_raw_handler;
+extern uint32_t stub_accel_samples;
+extern AccelSamplingRate stub_accel_rate;
+extern AccelTapHandler stub_tap_handler;
+extern BatteryStateHandler stub_battery_handler;
+extern AppWorkerMessageHandler stub_message_handler;
+extern StubLightHook stub_light_hook;
+extern StubAppMessageHook stub_app_message_hook;
+extern BatteryChargeState stub_battery;  /* what peek returns */
+extern FILE *stub_datalog_out;          /* data logging items go here */
+extern uint32_t stub_datalog_calls;
+extern uint32_t stub_datalog_items;
+
+void stub_advance(uint64_t now_ms);
+void stub_reset(void);
+
+#endif /* STUB_PEBBLE_WORKER_H */
@@ -0,0 +1,620 @@
+/*
+ * Host-side implementation of the stub app SDK.
+ *
+ * The UI is a shell: windows, layers and menus are allocated so the app
+ * can create, push and destroy them, but nothing is drawn.  The wakeup
+ * table follows the watch's rules closely enough to exercise the app's
+ * wakeup planner; the simulator reads it back to fire wakeups when the
+ * virtual clock reaches them.
+ */
+#include <stdlib.h>
+#include "pebble.h"
+
+StubWakeup stub_wakeups[STUB_WAKEUPS];
+AppLaunchReason stub_launch_reason = APP_LAUNCH_USER;
+StubWakeup stub_launch_event;
+void (*stub_event_hook)(void) = NULL;
+bool stub_worker_running = false;
+bool stub_worker_declined = false;
+
+uint32_t stub_wakeup_calls = 0;
+uint32_t stub_wakeup_refused = 0;
+uint32_t stub_worker_launches = 0;
+uint32_t stub_ui_created = 0;
+
+static WakeupId stub_next_id = 1;
+
+
+/****************************************************************************
+ * UI shell
+ ****************************************************************************/
+
+struct Layer {
+    GRect frame;
+    LayerUpdateProc update_proc;
+};
+
+struct TextLayer {
+    Layer layer;
+    const char *text;
+};
+
+struct Window {
+    Layer root;
+    WindowHandlers handlers;
+    bool loaded;
+};
+
+struct SimpleMenuLayer {
+    Layer layer;
+    int32_t selected;
+};
+
+struct NumberWindow {
+    Window window;                      /* first: the app casts to Window * */
+    int32_t value;
+    int32_t min;
+    int32_t max;
+};
+
+#define STUB_WINDOW_STACK 8
+
+static Window *stub_stack[STUB_WINDOW_STACK];
+static int stub_depth = 0;
+
+static const GRect stub_screen = { { 0, 0 }, { 144, 168 } };
+
+
+Window *
+window_stack_get_top_window (void)
+{
+    return(stub_depth ? stub_stack[stub_depth - 1] : NULL);
+}
+
+
+GFont
+fonts_get_system_font (const char *font_key)
+{
+    return((GFont)font_key);
+}
+
+void
+graphics_draw_line (GContext *ctx, GPoint p0, GPoint p1)
+{
+}
+
+
+Layer *
+layer_create (GRect frame)
+{
+    Layer *layer = calloc(1, sizeof(*layer));
+
+    layer->frame = frame;
+    stub_ui_created++;
+    return(layer);
+}
+
+void
+layer_destroy (Layer *layer)
+{
+    free(layer);
+}
+
+void
+layer_add_child (Layer *parent, Layer *child)
+{
+}
+
+void
+layer_mark_dirty (Layer *layer)
+{
+}
+
+void
+layer_set_update_proc (Layer *layer, LayerUpdateProc update_proc)
+{
+    layer->update_proc = update_proc;
+}
+
+GRect
+layer_get_frame (const Layer *layer)
+{
+    return(layer->frame);
+}
+
+GRect
+layer_get_bounds (const Layer *layer)
+{
+    return(GRect(0, 0, layer->frame.size.w, layer->frame.size.h));
+}
+
+
+TextLayer *
+text_layer_create (GRect frame)
+{
+    TextLayer *text_layer = calloc(1, sizeof(*text_layer));
+
+    text_layer->layer.frame = frame;
+    stub_ui_created++;
+    return(text_layer);
+}
+
+void
+text_layer_destroy (TextLayer *text_layer)
+{
+    free(text_layer);
+}
+
+Layer *
+text_layer_get_layer (TextLayer *text_layer)
+{
+    return(&text_layer->layer);
+}
+
+void
+text_layer_set_text (TextLayer *text_layer, const char *text)
+{
+    if (text_layer)
+        text_layer->text = text;
+}
+
+void
+text_layer_set_font (TextLayer *text_layer, GFont font)
+{
+}
+
+void
+text_layer_set_text_alignment (TextLayer *text_layer, GTextAlignment alignment)
+{
+}
+
+void
+text_layer_set_overflow_mode (TextLayer *text_layer, GTextOverflowMode mode)
+{
+}
+
+
+Window *
+window_create (void)
+{
+    Window *window = calloc(1, sizeof(*window));
+
+    window->root.frame = stub_screen;
+    stub_ui_created++;
+    return(window);
+}
+
+void
+window_destroy (Window *window)
+{
+    int i;
+
+    if (window == NULL)
+        return;
+    for (i = 0 ; i < stub_depth ; i++) {
+        if (stub_stack[i] == window) {
+            memmove(&stub_stack[i], &stub_stack[i + 1],
+                    (stub_depth - i - 1) * sizeof(*stub_stack));
+            stub_depth--;
+            break;
+        }
+    }
+    if (window->loaded && window->handlers.unload)
+        window->handlers.unload(window);
+    free(window);
+}
+
+Layer *
+window_get_root_layer (const Window *window)
+{
+    return((Layer *)&window->root);
+}
+
+void
+window_set_window_handlers (Window *window, WindowHandlers handlers)
+{
+    window->handlers = handlers;
+}
+
+void
+window_set_click_config_provider (Window *window,
+                                  ClickConfigProvider click_config_provider)
+{
+}
+
+void
+window_single_click_subscribe (ButtonId button_id, ClickHandler handler)
+{
+}
+
+void
+window_single_repeating_click_subscribe (ButtonId button_id,
+                                         uint16_t repeat_interval_ms,
+                                         ClickHandler handler)
+{
+}
+
+static void
+stub_window_appear (Window *window, bool appear)
+{
+    WindowHandler handler;
+
+    if (window == NULL)
+        return;
+    handler = appear ? window->handlers.appear : window->handlers.disappear;
+    if (handler)
+        handler(window);
+}
+
+void
+window_stack_push (Window *window, bool animated)
+{
+    if (stub_depth == STUB_WINDOW_STACK) {
+        fprintf(stderr, "stub: window stack full\n");
+        return;
+    }
+    stub_window_appear(window_stack_get_top_window(), false);
+    stub_stack[stub_depth++] = window;
+    if (!window->loaded) {
+        window->loaded = true;
+        if (window->handlers.load)
+            window->handlers.load(window);
+    }
+    stub_window_appear(window, true);
+}
+
+/* As on the watch, a popped window is unloaded */
+Window *
+window_stack_pop (bool animated)
+{
+    Window *window;
+
+    if (stub_depth == 0)
+        return(NULL);
+    window = stub_stack[--stub_depth];
+    stub_window_appear(window, false);
+    if (window->loaded) {
+        window->loaded = false;
+        if (window->handlers.unload)
+            window->handlers.unload(window);
+    }
+    stub_window_appear(window_stack_get_top_window(), true);
+    return(window);
+}
+
+
+
+SimpleMenuLayer *
+simple_menu_layer_create (GRect frame, Window *window,
+                          const SimpleMenuSection *sections,
+                          int32_t num_sections, void *callback_context)
+{
+    SimpleMenuLayer *menu = calloc(1, sizeof(*menu));
+
+    menu->layer.frame = frame;
+    stub_ui_created++;
+    return(menu);
+}
+
+void
+simple_menu_layer_destroy (SimpleMenuLayer *menu_layer)
+{
+    free(menu_layer);
+}
+
+Layer *
+simple_menu_layer_get_layer (const SimpleMenuLayer *simple_menu)
+{
+    return((Layer *)&simple_menu->layer);
+}
+
+void
+simple_menu_layer_set_selected_index (SimpleMenuLayer *simple_menu,
+                                      int32_t index, bool animated)
+{
+    simple_menu->selected = index;
+}
+
+
+NumberWindow *
+number_window_create (const char *label, NumberWindowCallbacks callbacks,
+                      void *callback_context)
+{
+    NumberWindow *number_window = calloc(1, sizeof(*number_window));
+
+    number_window->window.root.frame = stub_screen;
+    stub_ui_created++;
+    return(number_window);
+}
+
+void
+number_window_destroy (NumberWindow *number_window)
+{
+    window_destroy(&number_window->window);
+}
+
+int32_t
+number_window_get_value (const NumberWindow *number_window)
+{
+    return(number_window->value);
+}
+
+void
+number_window_set_value (NumberWindow *number_window, int32_t value)
+{
+    number_window->value = value;
+}
+
+void
+number_window_set_max (NumberWindow *number_window, int32_t max)
+{
+    number_window->max = max;
+}
+
+void
+number_window_set_min (NumberWindow *number_window, int32_t min)
+{
+    number_window->min = min;
+}
+
+
+/****************************************************************************
+ * Launch and wakeups
+ ****************************************************************************/
+
+AppLaunchReason
+launch_reason (void)
+{
+    return(stub_launch_reason);
+}
+
+bool
+wakeup_get_launch_event (WakeupId *wakeup_id, int32_t *cookie)
+{
+    if (stub_launch_reason != APP_LAUNCH_WAKEUP)
+        return(false);
+    *wakeup_id = stub_launch_event.id;
+    *cookie = stub_launch_event.cookie;
+    return(true);
+}
+
+
+static StubWakeup *
+stub_wakeup_find (WakeupId id)
+{
+    int i;
+
+    if (id <= 0)
+        return(NULL);
+    for (i = 0 ; i < STUB_WAKEUPS ; i++) {
+        if (stub_wakeups[i].used && !stub_wakeups[i].foreign &&
+            stub_wakeups[i].id == id)
+            return(&stub_wakeups[i]);
+    }
+    return(NULL);
+}
+
+int
+stub_wakeup_count (bool foreign)
+{
+    int i, n = 0;
+
+    for (i = 0 ; i < STUB_WAKEUPS ; i++) {
+        if (stub_wakeups[i].used && stub_wakeups[i].foreign == foreign)
+            n++;
+    }
+    return(n);
+}
+
+static StubWakeup *
+stub_wakeup_insert (time_t when, bool foreign, status_t *status)
+{
+    StubWakeup *free_slot = NULL;
+    int i;
+
+    if (when <= stub_time(NULL)) {
+        *status = E_INVALID_ARGUMENT;
+        return(NULL);
+    }
+    if (!foreign && stub_wakeup_count(false) >= STUB_APP_WAKEUPS) {
+        *status = E_OUT_OF_RESOURCES;
+        return(NULL);
+    }
+    for (i = 0 ; i < STUB_WAKEUPS ; i++) {
+        if (!stub_wakeups[i].used) {
+            if (free_slot == NULL)
+                free_slot = &stub_wakeups[i];
+        } else if (when > stub_wakeups[i].when - STUB_WAKEUP_SPACING &&
+                   when < stub_wakeups[i].when + STUB_WAKEUP_SPACING) {
+            *status = E_RANGE;
+            return(NULL);
+        }
+    }
+    if (free_slot == NULL) {
+        *status = E_OUT_OF_RESOURCES;
+        return(NULL);
+    }
+    memset(free_slot, 0, sizeof(*free_slot));
+    free_slot->used = true;
+    free_slot->foreign = foreign;
+    free_slot->when = when;
+    free_slot->id = stub_next_id++;
+    *status = S_SUCCESS;
+    return(free_slot);
+}
+
+WakeupId
+wakeup_schedule (time_t timestamp, int32_t cookie, bool notify_if_missed)
+{
+    StubWakeup *w;
+    status_t status;
+
+    stub_wakeup_calls++;
+    w = stub_wakeup_insert(timestamp, false, &status);
+    if (w == NULL) {
+        if (status == E_RANGE)
+            stub_wakeup_refused++;
+        return(status);
+    }
+    w->cookie = cookie;
+    return(w->id);
+}
+
+void
+wakeup_cancel (WakeupId wakeup_id)
+{
+    StubWakeup *w = stub_wakeup_find(wakeup_id);
+
+    if (w)
+        w->used = false;
+}
+
+void
+wakeup_cancel_all (void)
+{
+    int i;
+
+    for (i = 0 ; i < STUB_WAKEUPS ; i++) {
+        if (!stub_wakeups[i].foreign)
+            stub_wakeups[i].used = false;
+    }
+}
+
+bool
+wakeup_query (WakeupId wakeup_id, time_t *timestamp)
+{
+    StubWakeup *w = stub_wakeup_find(wakeup_id);
+
+    if (w == NULL)
+        return(false);
+    if (timestamp)
+        *timestamp = w->when;
+    return(true);
+}
+
+
+/*
+ * Another app's wakeup, which takes up the minute either side of it.
+ */
+bool
+stub_wakeup_add_foreign (time_t when)
+{
+    status_t status;
+
+    return(stub_wakeup_insert(when, true, &status) != NULL);
+}
+
+/*
+ * Remove and return the earliest wakeup, ours or foreign, due by now.
+ */
+bool
+stub_wakeup_take_due (time_t now, StubWakeup *out)
+{
+    StubWakeup *next = NULL;
+    int i;
+
+    for (i = 0 ; i < STUB_WAKEUPS ; i++) {
+        if (stub_wakeups[i].used && stub_wakeups[i].when <= now &&
+            (next == NULL || stub_wakeups[i].when < next->when))
+            next = &stub_wakeups[i];
+    }
+    if (next == NULL)
+        return(false);
+    *out = *next;
+    next->used = false;
+    return(true);
+}
+
+
+void
+vibes_short_pulse (void)
+{
+}
+
+void
+vibes_double_pulse (void)
+{
+}
+
+
+/****************************************************************************
+ * Worker and event loop
+ ****************************************************************************/
+
+bool
+app_worker_is_running (void)
+{
+    return(stub_worker_running);
+}
+
+AppWorkerResult
+app_worker_launch (void)
+{
+    if (stub_worker_running)
+        return(APP_WORKER_RESULT_ALREADY_RUNNING);
+    if (stub_worker_declined)
+        return(APP_WORKER_RESULT_ASKING_CONFIRMATION);
+    stub_worker_running = true;
+    stub_worker_launches++;
+    return(APP_WORKER_RESULT_SUCCESS);
+}
+
+AppWorkerResult
+app_worker_kill (void)
+{
+    if (!stub_worker_running)
+        return(APP_WORKER_RESULT_NOT_RUNNING);
+    stub_worker_running = false;
+    return(APP_WORKER_RESULT_SUCCESS);
+}
+
+/* The simulated worker has no message handler; messages are dropped */
+AppWorkerResult
+app_worker_send_message (uint8_t type, AppWorkerMessage *message)
+{
+    return(stub_worker_running ? APP_WORKER_RESULT_SUCCESS :
+           APP_WORKER_RESULT_NOT_RUNNING);
+}
+
+bool
+app_worker_message_subscribe (AppWorkerMessageHandler handler)
+{
+    return(true);
+}
+
+bool
+app_worker_message_unsubscribe (void)
+{
+    return(true);
+}
+
+/*
+ * Run the simulator's hook, then leave the way the user does, backing
+ * out of every window.
+ */
+void
+app_event_loop (void)
+{
+    if (stub_event_hook)
+        stub_event_hook();
+    while (stub_depth)
+        window_stack_pop(true);
+}
+
+
+void
+stub_app_reset (void)
+{
+    memset(stub_wakeups, 0, sizeof(stub_wakeups));
+    memset(stub_stack, 0, sizeof(stub_stack));
+    stub_depth = 0;
+    stub_next_id = 1;
+    stub_launch_reason = APP_LAUNCH_USER;
+    stub_event_hook = NULL;
+    stub_worker_running = false;
+    stub_worker_declined = false;
+    stub_wakeup_calls = 0;
+    stub_wakeup_refused = 0;
+    stub_worker_launches = 0;
+    stub_ui_created = 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Host-side implementation of the parts of the stub SDK shared by the
+ * app and the worker.  The wall clock is virtual: STUB_EPOCH plus
+ * stub_now_ms, moved only by the tool driving the stubs.  Local time
+ * goes through the host's time zone rules, so TZ can be set to test
+ * DST changes.
+ */
+#include <stdarg.h>
+#include <stdlib.h>
+#include "stub_common.h"
+
+#undef time
+
+uint64_t stub_now_ms = 0;
+bool stub_log_enabled = false;
+uint32_t stub_persist_writes = 0;         /* flash writes, for wear */
+uint32_t stub_persist_reads = 0;
+
+
+void
+app_log (uint8_t log_level, const char *src_filename, int src_line_number,
+         const char *fmt, ...)
+{
+    va_list ap;
+
+    if (!stub_log_enabled)
+        return;
+
+    fprintf(stderr, "[%8llu] %s:%d ", (unsigned long long)stub_now_ms,
+            src_filename, src_line_number);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+
+time_t
+stub_time (time_t *tloc)
+{
+    time_t t = STUB_EPOCH + (time_t)(stub_now_ms / 1000);
+
+    if (tloc)
+        *tloc = t;
+    return(t);
+}
+
+
+uint16_t
+time_ms (time_t *tloc, uint16_t *out_ms)
+{
+    uint16_t ms = (uint16_t)(stub_now_ms % 1000);
+
+    stub_time(tloc);
+    if (out_ms)
+        *out_ms = ms;
+    return(ms);
+}
+
+
+/*
+ * Next local day, hour and minute strictly in the future, through the
+ * host's own time zone rules so DST changes behave as on the watch.
+ */
+time_t
+clock_to_timestamp (WeekDay day, int hour, int minute)
+{
+    time_t now = stub_time(NULL);
+    struct tm tm = *localtime(&now);
+    int days = 0, week;
+    time_t t;
+
+    if (day != TODAY)
+        days = ((int)day - SUNDAY - tm.tm_wday + 7) % 7;
+    for (week = 0 ; ; week += 7) {
+        tm = *localtime(&now);
+        tm.tm_mday += days + week;
+        tm.tm_hour = hour;
+        tm.tm_min = minute;
+        tm.tm_sec = 0;
+        tm.tm_isdst = -1;
+        t = mktime(&tm);
+        if (t > now)
+            return(t);
+    }
+}
+
+
+/****************************************************************************
+ * Persistent storage
+ ****************************************************************************/
+
+#define STUB_PERSIST_KEYS 64
+#define STUB_PERSIST_MAX 256
+
+static struct {
+    bool exists;
+    size_t size;
+    uint8_t data[STUB_PERSIST_MAX];
+} stub_persist[STUB_PERSIST_KEYS];
+
+bool
+persist_exists (uint32_t key)
+{
+    return(key < STUB_PERSIST_KEYS && stub_persist[key].exists);
+}
+
+int
+persist_read_data (uint32_t key, void *buffer, size_t buffer_size)
+{
+    size_t n;
+
+    stub_persist_reads++;
+    if (!persist_exists(key))
+        return(E_DOES_NOT_EXIST);
+    n = stub_persist[key].size < buffer_size ? stub_persist[key].size : buffer_size;
+    memcpy(buffer, stub_persist[key].data, n);
+    return((int)n);
+}
+
+int
+persist_write_data (uint32_t key, const void *data, size_t size)
+{
+    if (key >= STUB_PERSIST_KEYS || size > STUB_PERSIST_MAX)
+        return(E_INVALID_ARGUMENT);
+    stub_persist_writes++;
+    stub_persist[key].exists = true;
+    stub_persist[key].size = size;
+    memcpy(stub_persist[key].data, data, size);
+    return((int)size);
+}
+
+int32_t
+persist_read_int (uint32_t key)
+{
+    int32_t val = 0;
+
+    persist_read_data(key, &val, sizeof(val));
+    return(val);
+}
+
+bool
+persist_read_bool (uint32_t key)
+{
+    return(persist_read_int(key) != 0);
+}
+
+status_t
+persist_write_int (uint32_t key, int32_t value)
+{
+    return(persist_write_data(key, &value, sizeof(value)));
+}
+
+status_t
+persist_write_bool (uint32_t key, bool value)
+{
+    return(persist_write_int(key, value ? 1 : 0));
+}
+
+status_t
+persist_delete (uint32_t key)
+{
+    if (!persist_exists(key))
+        return(E_DOES_NOT_EXIST);
+    stub_persist[key].exists = false;
+    return(S_SUCCESS);
+}
+
+void
+stub_persist_reset (void)
+{
+    memset(stub_persist, 0, sizeof(stub_persist));
+    stub_persist_writes = 0;
+    stub_persist_reads = 0;
+}
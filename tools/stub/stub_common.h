@@ -0,0 +1,92 @@
+/*
+ * Parts of the stub SDK shared by the app (pebble.h) and the worker
+ * (pebble_worker.h): logging, the virtual clock, persistent storage and
+ * the worker message layout.
+ */
+#ifndef STUB_COMMON_H
+#define STUB_COMMON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+/* Logging */
+typedef enum {
+    APP_LOG_LEVEL_ERROR = 1,
+    APP_LOG_LEVEL_WARNING = 50,
+    APP_LOG_LEVEL_INFO = 100,
+    APP_LOG_LEVEL_DEBUG = 200,
+    APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number,
+             const char *fmt, ...);
+#define APP_LOG(level, fmt, args...) \
+    app_log(level, __FILE__, __LINE__, fmt, ## args)
+
+#define ARRAY_LENGTH(array) (sizeof((array)) / sizeof((array)[0]))
+
+/* Virtual wall clock; STUB_EPOCH is the time at virtual millisecond 0 */
+#define STUB_EPOCH	1500000000
+time_t stub_time(time_t *tloc);
+#define time(t) stub_time(t)
+
+typedef enum {
+    TODAY = 0, SUNDAY, MONDAY, TUESDAY, WEDNESDAY, THURSDAY, FRIDAY, SATURDAY,
+} WeekDay;
+
+time_t clock_to_timestamp(WeekDay day, int hour, int minute);
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+/* Persistent storage */
+typedef enum {
+    S_SUCCESS = 0,
+    E_ERROR = -1,
+    E_UNKNOWN = -2,
+    E_INTERNAL = -3,
+    E_INVALID_ARGUMENT = -4,
+    E_OUT_OF_MEMORY = -5,
+    E_OUT_OF_STORAGE = -6,
+    E_OUT_OF_RESOURCES = -7,
+    E_RANGE = -8,
+    E_DOES_NOT_EXIST = -9,
+    E_INVALID_OPERATION = -10,
+    E_BUSY = -11,
+} StatusCode;
+
+typedef int32_t status_t;
+
+bool persist_exists(uint32_t key);
+int32_t persist_read_int(uint32_t key);
+bool persist_read_bool(uint32_t key);
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size);
+status_t persist_write_int(uint32_t key, int32_t value);
+status_t persist_write_bool(uint32_t key, bool value);
+int persist_write_data(uint32_t key, const void *data, size_t size);
+status_t persist_delete(uint32_t key);
+
+/* Messages between the app and the worker */
+typedef struct {
+    uint16_t data0;
+    uint16_t data1;
+    uint16_t data2;
+} AppWorkerMessage;
+
+typedef void (*AppWorkerMessageHandler)(uint16_t type, AppWorkerMessage *data);
+
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler);
+bool app_worker_message_unsubscribe(void);
+
+extern uint64_t stub_now_ms;
+extern bool stub_log_enabled;
+extern uint32_t stub_persist_writes;
+extern uint32_t stub_persist_reads;
+
+void stub_persist_reset(void);
+
+#endif /* STUB_COMMON_H */
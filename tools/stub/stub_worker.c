@@ -0,0 +1,291 @@
+/*
+ * Host-side implementation of the stub worker SDK.
+ *
+ * Everything runs off a virtual millisecond clock (stub_now_ms) which only
+ * moves when the replay tool calls stub_advance().  Timers fire in
+ * deadline order as the clock passes them.
+ */
+#include <stdlib.h>
+#include "pebble_worker.h"
+
+AccelDataHandler stub_accel_handler = NULL;
+AccelRawDataHandler stub_accel_raw_handler = NULL;
+uint32_t stub_accel_samples = 0;
+AccelSamplingRate stub_accel_rate = ACCEL_SAMPLING_25HZ; /* SDK default */
+AccelTapHandler stub_tap_handler = NULL;
+BatteryStateHandler stub_battery_handler = NULL;
+AppWorkerMessageHandler stub_message_handler = NULL;
+StubLightHook stub_light_hook = NULL;
+StubAppMessageHook stub_app_message_hook = NULL;
+BatteryChargeState stub_battery = { 100, false, false };
+FILE *stub_datalog_out = NULL;
+uint32_t stub_datalog_calls = 0;
+uint32_t stub_datalog_items = 0;
+
+static bool stub_light = false;
+
+
+/****************************************************************************
+ * Accelerometer and battery services
+ ****************************************************************************/
+
+int
+accel_service_set_sampling_rate (AccelSamplingRate rate)
+{
+    stub_accel_rate = rate;
+    return(0);
+}
+
+void
+accel_data_service_subscribe (uint32_t samples_per_update,
+                              AccelDataHandler handler)
+{
+    stub_accel_samples = samples_per_update;
+    stub_accel_handler = handler;
+    stub_accel_raw_handler = NULL;
+}
+
+void
+accel_raw_data_service_subscribe (uint32_t samples_per_update,
+                                  AccelRawDataHandler handler)
+{
+    stub_accel_samples = samples_per_update;
+    stub_accel_raw_handler = handler;
+    stub_accel_handler = NULL;
+}
+
+void
+accel_data_service_unsubscribe (void)
+{
+    stub_accel_handler = NULL;
+    stub_accel_raw_handler = NULL;
+}
+
+void
+accel_tap_service_subscribe (AccelTapHandler handler)
+{
+    stub_tap_handler = handler;
+}
+
+void
+accel_tap_service_unsubscribe (void)
+{
+    stub_tap_handler = NULL;
+}
+
+void
+battery_state_service_subscribe (BatteryStateHandler handler)
+{
+    stub_battery_handler = handler;
+}
+
+void
+battery_state_service_unsubscribe (void)
+{
+    stub_battery_handler = NULL;
+}
+
+BatteryChargeState
+battery_state_service_peek (void)
+{
+    return(stub_battery);
+}
+
+
+/****************************************************************************
+ * Timers
+ ****************************************************************************/
+
+#define STUB_MAX_TIMERS 16
+
+struct AppTimer {
+    bool used;
+    uint64_t deadline;
+    AppTimerCallback callback;
+    void *data;
+};
+
+static struct AppTimer stub_timers[STUB_MAX_TIMERS];
+
+AppTimer *
+app_timer_register (uint32_t timeout_ms, AppTimerCallback callback,
+                    void *callback_data)
+{
+    int i;
+
+    for (i = 0 ; i < STUB_MAX_TIMERS ; i++) {
+        if (!stub_timers[i].used) {
+            stub_timers[i].used = true;
+            stub_timers[i].deadline = stub_now_ms + timeout_ms;
+            stub_timers[i].callback = callback;
+            stub_timers[i].data = callback_data;
+            return(&stub_timers[i]);
+        }
+    }
+    fprintf(stderr, "stub: out of timers\n");
+    return(NULL);
+}
+
+bool
+app_timer_reschedule (AppTimer *timer, uint32_t new_timeout_ms)
+{
+    if (timer == NULL || !timer->used)
+        return(false);
+    timer->deadline = stub_now_ms + new_timeout_ms;
+    return(true);
+}
+
+void
+app_timer_cancel (AppTimer *timer)
+{
+    if (timer)
+        timer->used = false;
+}
+
+
+/*
+ * Move the virtual clock forward, firing any timers that come due on
+ * the way in deadline order.
+ */
+void
+stub_advance (uint64_t now_ms)
+{
+    struct AppTimer *next;
+    AppTimerCallback cb;
+    int i;
+
+    for (;;) {
+        next = NULL;
+        for (i = 0 ; i < STUB_MAX_TIMERS ; i++) {
+            if (stub_timers[i].used && stub_timers[i].deadline <= now_ms &&
+                (next == NULL || stub_timers[i].deadline < next->deadline))
+                next = &stub_timers[i];
+        }
+        if (next == NULL)
+            break;
+        if (next->deadline > stub_now_ms)
+            stub_now_ms = next->deadline;
+        next->used = false;
+        cb = next->callback;
+        cb(next->data);
+    }
+    if (now_ms > stub_now_ms)
+        stub_now_ms = now_ms;
+}
+
+
+/****************************************************************************
+ * Worker messages
+ ****************************************************************************/
+
+bool
+app_worker_message_subscribe (AppWorkerMessageHandler handler)
+{
+    stub_message_handler = handler;
+    return(true);
+}
+
+bool
+app_worker_message_unsubscribe (void)
+{
+    stub_message_handler = NULL;
+    return(true);
+}
+
+/*
+ * From the worker to the app.  The replay tool plays the app's part by
+ * calling stub_message_handler directly.
+ */
+void
+app_worker_send_message (uint8_t type, AppWorkerMessage *data)
+{
+    if (stub_app_message_hook)
+        stub_app_message_hook(type, data);
+}
+
+
+/****************************************************************************
+ * Data logging: one session at a time, items written out as they are
+ * logged, the way the phone would receive them
+ ****************************************************************************/
+
+struct DataLoggingSession {
+    bool open;
+    uint32_t tag;
+    uint16_t item_length;
+};
+
+static struct DataLoggingSession stub_session;
+
+DataLoggingSessionRef
+data_logging_create (uint32_t tag, DataLoggingItemType item_type,
+                     uint16_t item_length, bool resume)
+{
+    stub_session.open = true;
+    stub_session.tag = tag;
+    stub_session.item_length = item_length;
+    return(&stub_session);
+}
+
+void
+data_logging_finish (DataLoggingSessionRef logging_session)
+{
+    logging_session->open = false;
+}
+
+DataLoggingResult
+data_logging_log (DataLoggingSessionRef logging_session, const void *data,
+                  uint32_t num_items)
+{
+    if (!logging_session->open)
+        return(DATA_LOGGING_CLOSED);
+    stub_datalog_calls++;
+    stub_datalog_items += num_items;
+    if (stub_datalog_out)
+        fwrite(data, logging_session->item_length, num_items, stub_datalog_out);
+    return(DATA_LOGGING_SUCCESS);
+}
+
+
+/****************************************************************************
+ * Light and event loop
+ ****************************************************************************/
+
+void
+light_enable (bool enable)
+{
+    if (enable != stub_light && stub_light_hook)
+        stub_light_hook(stub_now_ms, enable);
+    stub_light = enable;
+}
+
+void
+light_enable_interaction (void)
+{
+    light_enable(true);
+}
+
+void
+worker_event_loop (void)
+{
+    /* Nothing to do: the replay tool drives all events */
+}
+
+
+void
+stub_reset (void)
+{
+    memset(stub_timers, 0, sizeof(stub_timers));
+    stub_now_ms = 0;
+    stub_light = false;
+    stub_accel_handler = NULL;
+    stub_accel_raw_handler = NULL;
+    stub_accel_samples = 0;
+    stub_accel_rate = ACCEL_SAMPLING_25HZ;
+    stub_tap_handler = NULL;
+    stub_battery_handler = NULL;
+    stub_message_handler = NULL;
+    stub_session.open = false;
+    stub_datalog_calls = 0;
+    stub_datalog_items = 0;
+}
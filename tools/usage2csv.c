@@ -0,0 +1,96 @@
+/*
+ * Decode the worker's usage records (worker_src/usage.h) to CSV.
+ *
+ * Input is the records as the data logging session delivers them, one
+ * after another with nothing in between: what a phone-side receiver
+ * saves for tag USAGE_TAG, or the file written by `replay -u`.  With no
+ * file, or "-", standard input is read.  One CSV line per record:
+ *
+ *	time,utc,event,reason,battery,charging,plugged,dwell_ms,lit_s
+ */
+#include <stdlib.h>
+#include "stub/pebble_worker.h"
+#include "../worker_src/usage.h"
+
+#undef time
+
+/* By STATS_ON_* */
+static const char *reasons[] = { "none", "raise", "charging", "plugged" };
+
+
+static unsigned
+get16 (const uint8_t *p)
+{
+    return(p[0] | (p[1] << 8));
+}
+
+static unsigned long
+get32 (const uint8_t *p)
+{
+    return((unsigned long)get16(p) | ((unsigned long)get16(p + 2) << 16));
+}
+
+
+static int
+decode (FILE *in, const char *name)
+{
+    uint8_t rec[USAGE_RECORD_SIZE];
+    char utc[32];
+    time_t t;
+    size_t n;
+    unsigned long count = 0;
+    const char *event;
+
+    while ((n = fread(rec, 1, sizeof(rec), in)) == sizeof(rec)) {
+        t = (time_t)get32(rec);
+        strftime(utc, sizeof(utc), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+        event = rec[4] == USAGE_LIGHT_ON ? "on" :
+            rec[4] == USAGE_LIGHT_OFF ? "off" : "?";
+        printf("%lu,%s,%s,%s,%u,%u,%u,%u,%.1f\n",
+               get32(rec), utc, event,
+               rec[5] < sizeof(reasons) / sizeof(*reasons) ? reasons[rec[5]] : "?",
+               rec[6], (rec[7] & USAGE_CHARGING) != 0,
+               (rec[7] & USAGE_PLUGGED) != 0,
+               get16(rec + 8), get16(rec + 10) / 10.0);
+        count++;
+    }
+    if (n != 0) {
+        fprintf(stderr, "%s: %zu stray bytes after record %lu\n",
+                name, n, count);
+        return(1);
+    }
+    return(0);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    FILE *in;
+    int i, err = 0;
+
+    if (argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0') {
+        fprintf(stderr, "usage: %s [file ...]\n", argv[0]);
+        return(2);
+    }
+
+    printf("time,utc,event,reason,battery,charging,plugged,dwell_ms,lit_s\n");
+    if (argc == 1)
+        return(decode(stdin, "stdin"));
+
+    for (i = 1 ; i < argc ; i++) {
+        if (strcmp(argv[i], "-") == 0) {
+            err |= decode(stdin, "stdin");
+            continue;
+        }
+        in = fopen(argv[i], "rb");
+        if (!in) {
+            perror(argv[i]);
+            err = 1;
+            continue;
+        }
+        err |= decode(in, argv[i]);
+        fclose(in);
+    }
+    return(err);
+}
@@ -0,0 +1,400 @@
+/*
+ * Host-side simulation of the app's wakeup scheduling.
+ *
+ * The app (src/backlight.c) is compiled unchanged against the stub app
+ * SDK in tools/stub/pebble.h and its main() is run the way the watch
+ * would run it: by the user, or by one of its wakeups firing.  The
+ * virtual clock steps a minute at a time over months of days, in the
+ * host's time zone rules, so DST changes come round as they would on
+ * the wrist.  Along the way:
+ *
+ *	- other apps book wakeups at random, taking slots near ours;
+ *	- the user opens the app now and then, and sometimes turns the
+ *	  worker off, which leaves the app a start wakeup to book;
+ *	- the user toggles the worker from quick launch;
+ *	- optionally the user declines some of the worker launches a start
+ *	  wakeup asks for (-x);
+ *	- optionally the time zone changes part way through (-Z).
+ *
+ * The schedule is also worked out minute by minute straight from the
+ * settings, without schedule.h, and compared with the app's compiled
+ * table.  Reported: wakeup_schedule() calls and refusals, how far each
+ * start wakeup landed from the window start it was for (drift), window
+ * starts that passed with the worker stopped and no wakeup (missed), the
+ * most of our wakeup slots ever in use, flash writes, UI objects built,
+ * persist reads and writes and host time per wakeup launch, and any
+ * table mismatches.  A window start whose launch was declined is not
+ * counted as missed, nor is a start the clock comes round to again in
+ * the hour given back when DST ends: that is the same window, which the
+ * worker and the app's schedule treat as one.
+ *
+ * The exit status is 1 if anything was missed or mismatched.
+ */
+#include <stdlib.h>
+#include <getopt.h>
+#include "stub/pebble.h"
+#include "../src/log.h"
+#include "../src/config.h"
+
+#undef time
+
+/* From backlight.c, main() renamed by the Makefile */
+int app_main(void);
+void top_menu_callback(int index, void *context);
+extern Schedule schedule;
+extern SchedTable sched_table;
+extern WakeupId start_alarm_id;
+extern WakeupId stop_alarm_id;
+extern time_t wakeup_slot[2];
+
+/* Wakeup cookies, as in backlight.c */
+#define TIME_START	0
+#define TIME_STOP	1
+
+#define DRIFT_SEARCH	(60 * 60)       /* seconds either side of a wakeup */
+
+static uint32_t rng_state;
+static uint32_t failed;
+static SchedTable app_table;            /* as last compiled by the app */
+
+static uint32_t
+rng (void)
+{
+    /* xorshift32: the same run on every host */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return(rng_state);
+}
+
+/* True with probability per_day / minutes in a day */
+static bool
+chance (double per_day)
+{
+    return(rng() % (24 * 60 * 1000) < (uint32_t)(per_day * 1000));
+}
+
+
+/*
+ * The schedule the straightforward way: is local time t inside a window
+ * of its own day's profile, or of yesterday's running over midnight?
+ */
+static bool
+naive_active (const Schedule *s, time_t t)
+{
+    struct tm *tm = localtime(&t);
+    int m = tm->tm_hour * 60 + tm->tm_min;
+    const SchedWindow *win;
+    int back, day, w;
+
+    for (back = 0 ; back < 2 ; back++) {
+        day = (tm->tm_wday + 7 - back) % 7;
+        win = s->win[(s->weekend >> day) & 1 ? SCHED_WEEKEND : SCHED_WEEKDAY];
+        for (w = 0 ; w < SCHED_WINDOWS ; w++) {
+            if (win[w].start == win[w].stop)
+                continue;
+            if (win[w].start < win[w].stop) {
+                if (back == 0 && m >= win[w].start && m < win[w].stop)
+                    return(true);
+            } else if (back == 0 ? m >= win[w].start : m < win[w].stop) {
+                return(true);
+            }
+        }
+    }
+    return(false);
+}
+
+
+/*
+ * Is local time t a wall-clock time already seen an hour ago, in the
+ * hour repeated when DST ends?
+ */
+static bool
+repeated_hour (time_t t)
+{
+    struct tm now = *localtime(&t);
+    time_t h = t - 60 * 60;
+    struct tm before = *localtime(&h);
+
+    return(now.tm_isdst != before.tm_isdst && now.tm_hour == before.tm_hour &&
+           now.tm_min == before.tm_min);
+}
+
+
+/*
+ * Run the app as a fresh launch.  On the watch every launch is a new
+ * process, so the state the app keeps in globals starts out zeroed.
+ */
+static void
+launch (AppLaunchReason reason, void (*hook)(void))
+{
+    wakeup_slot[TIME_START] = 0;
+    wakeup_slot[TIME_STOP] = 0;
+    start_alarm_id = 0;
+    stop_alarm_id = 0;
+    memset(&schedule, 0, sizeof(schedule));
+    memset(&sched_table, 0, sizeof(sched_table));
+
+    stub_launch_reason = reason;
+    stub_event_hook = hook;
+    app_main();
+    stub_event_hook = NULL;
+    if (start_alarm_id < 0)
+        failed++;                       /* no slot could be found */
+    /* a start wakeup that launches the worker never loads the schedule */
+    if (sched_table.count)
+        app_table = sched_table;
+}
+
+/* The user picks "Toggle backlight" from the menu */
+static void
+user_toggle (void)
+{
+    top_menu_callback(0, NULL);
+}
+
+
+/* Daily window of -S, or a week with a bit of everything */
+static void
+sim_schedule (Schedule *s, int sh, int sm, int eh, int em, bool daily)
+{
+    static const SchedWindow weekday[SCHED_WINDOWS] = {
+        { 6 * 60 + 30, 8 * 60 + 30 },
+        { 12 * 60, 13 * 60 },
+        { 17 * 60 + 30, 23 * 60 + 30 },
+    };
+    static const SchedWindow weekend[SCHED_WINDOWS] = {
+        { 2 * 60 + 30, 3 * 60 + 30 },   /* skipped or doubled by DST */
+        { 9 * 60, 30 },                 /* over midnight */
+        { 0, 0 },
+    };
+
+    if (daily) {
+        schedule_daily(s, sh, sm, eh, em);
+        return;
+    }
+    schedule_clear(s);
+    memcpy(s->win[SCHED_WEEKDAY], weekday, sizeof(weekday));
+    memcpy(s->win[SCHED_WEEKEND], weekend, sizeof(weekend));
+}
+
+
+static void
+usage (const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-d days] [-f foreign] [-u opens] [-o off] [-q quick]\n"
+            "       %*s [-x declined] [-r seed] [-S hh:mm-hh:mm] [-z tz]\n"
+            "       %*s [-Z day:tz] [-v]\n"
+            "  -d  days to simulate (default 260, past both DST changes)\n"
+            "  -f  other apps' wakeups booked per day (default 6)\n"
+            "  -u  times a day the user opens the app (default 1)\n"
+            "  -o  share of those that turn the worker off (default 0.5)\n"
+            "  -q  times a day the user toggles from quick launch (default 0.5)\n"
+            "  -x  share of start wakeups whose worker launch is declined\n"
+            "  -r  random seed (default 1)\n"
+            "  -S  one daily window instead of the built-in week\n"
+            "  -z  time zone, as in TZ (default Central European)\n"
+            "  -Z  change the time zone on the given day\n"
+            "  -v  show app log output\n"
+            "The simulation starts at %s",
+            prog, (int)strlen(prog), "", (int)strlen(prog), "", ctime(&(time_t){ STUB_EPOCH }));
+    exit(2);
+}
+
+int
+main (int argc, char **argv)
+{
+    const char *tz = "CET-1CEST,M3.5.0,M10.5.0/3";
+    const char *new_tz = NULL;
+    int days = 260, tz_day = -1, sh = 0, sm = 0, eh = 0, em = 0;
+    double foreign = 6, opens = 1, off = 0.5, quick = 0.5, decline = 0;
+    bool daily = false, was, now_on, skip_start = false;
+    Settings settings;
+    StubWakeup w;
+    time_t t, end, pending = 0, e;
+    uint32_t user_launches = 0, wakeup_launches = 0, foreign_fired = 0;
+    uint32_t quick_launches = 0, declined = 0;
+    uint32_t wake_reads = 0, wake_writes = 0, r0, w0;
+    double wake_ns = 0;
+    uint32_t starts = 0, stopped_starts = 0, missed = 0, mismatches = 0;
+    uint32_t stray = 0, drifts = 0;
+    int32_t drift, drift_min = INT32_MAX, drift_max = INT32_MIN;
+    int64_t drift_sum = 0;
+    uint32_t seed = 1;
+    int max_slots = 0, n, c;
+    struct timespec t0, t1, l0, l1;
+
+    while ((c = getopt(argc, argv, "d:f:u:o:q:x:r:S:z:Z:v")) != -1) {
+        switch (c) {
+        case 'd': days = atoi(optarg); break;
+        case 'f': foreign = atof(optarg); break;
+        case 'u': opens = atof(optarg); break;
+        case 'o': off = atof(optarg); break;
+        case 'q': quick = atof(optarg); break;
+        case 'x': decline = atof(optarg); break;
+        case 'r': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'S':
+            if (sscanf(optarg, "%d:%d-%d:%d", &sh, &sm, &eh, &em) != 4)
+                usage(argv[0]);
+            daily = true;
+            break;
+        case 'z': tz = optarg; break;
+        case 'Z':
+            if (sscanf(optarg, "%d:", &tz_day) != 1 || !strchr(optarg, ':'))
+                usage(argv[0]);
+            new_tz = strchr(optarg, ':') + 1;
+            break;
+        case 'v': stub_log_enabled = true; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || days <= 0)
+        usage(argv[0]);
+
+    rng_state = seed | 1;
+    setenv("TZ", tz, 1);
+    tzset();
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    stub_persist_reset();
+    stub_app_reset();
+    stub_now_ms = 0;
+    settings_default(&settings);
+    sim_schedule(&settings.schedule, sh, sm, eh, em, daily);
+    settings_save(&settings);
+
+    /* first run: the user opens the app, which starts the worker */
+    launch(APP_LAUNCH_USER, NULL);
+    user_launches++;
+
+    t = STUB_EPOCH;
+    end = t + (time_t)days * 24 * 60 * 60;
+    was = naive_active(&settings.schedule, t);
+    for ( ; t < end ; t += 60) {
+        stub_now_ms = (uint64_t)(t - STUB_EPOCH) * 1000;
+        if (new_tz && (t - STUB_EPOCH) / (24 * 60 * 60) == tz_day) {
+            setenv("TZ", new_tz, 1);
+            tzset();
+            new_tz = NULL;
+        }
+
+        while (stub_wakeup_take_due(t, &w)) {
+            if (w.foreign) {
+                foreign_fired++;
+                continue;
+            }
+            stub_worker_declined = decline > 0 && w.cookie == TIME_START &&
+                !stub_worker_running && rng() % 1000 < decline * 1000;
+            stub_launch_event = w;
+            r0 = stub_persist_reads;
+            w0 = stub_persist_writes;
+            clock_gettime(CLOCK_MONOTONIC, &l0);
+            launch(APP_LAUNCH_WAKEUP, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &l1);
+            wake_ns += (l1.tv_sec - l0.tv_sec) * 1e9 + (l1.tv_nsec - l0.tv_nsec);
+            wake_reads += stub_persist_reads - r0;
+            wake_writes += stub_persist_writes - w0;
+            wakeup_launches++;
+            if (stub_worker_declined) {
+                /* the user chose to go without for this window */
+                declined++;
+                stub_worker_declined = false;
+                if (pending)
+                    pending = 0;
+                else
+                    skip_start = true;
+            }
+            if (w.cookie != TIME_START)
+                continue;
+
+            /* nearest window start to the wakeup */
+            for (e = 0 ; e <= DRIFT_SEARCH ; e += 60) {
+                if (naive_active(&settings.schedule, w.when - e) &&
+                    !naive_active(&settings.schedule, w.when - e - 60)) {
+                    e = -e;
+                    break;
+                }
+                if (naive_active(&settings.schedule, w.when + e) &&
+                    !naive_active(&settings.schedule, w.when + e - 60))
+                    break;
+            }
+            if (e > DRIFT_SEARCH) {
+                stray++;
+            } else {
+                drift = (int32_t)-e;
+                drift_sum += drift;
+                drifts++;
+                if (drift < drift_min)
+                    drift_min = drift;
+                if (drift > drift_max)
+                    drift_max = drift;
+            }
+        }
+
+        now_on = naive_active(&settings.schedule, t);
+        if (schedule_active(&app_table, t) != now_on)
+            mismatches++;
+        if (now_on && !was && repeated_hour(t)) {
+            /* the same window again, not a new start */
+        } else if (now_on && !was) {
+            starts++;
+            if (skip_start) {
+                skip_start = false;
+            } else if (!stub_worker_running) {
+                stopped_starts++;
+                pending = t;
+            }
+        } else if (!now_on && was && pending) {
+            LOG(APP_LOG_LEVEL_ERROR, "missed window start at %u", (uint)pending);
+            missed++;
+            pending = 0;
+        }
+        was = now_on;
+
+        if (chance(foreign))
+            stub_wakeup_add_foreign(t + 60 + rng() % (24 * 60 * 60));
+        if (chance(opens)) {
+            launch(APP_LAUNCH_USER, (rng() % 1000 < off * 1000) ? user_toggle : NULL);
+            user_launches++;
+        }
+        if (quick > 0 && chance(quick)) {
+            launch(APP_LAUNCH_QUICK_LAUNCH, NULL);
+            quick_launches++;
+        }
+        if (stub_worker_running)
+            pending = 0;                /* launched by a wakeup or the user */
+
+        n = stub_wakeup_count(false);
+        if (n > max_slots)
+            max_slots = n;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    printf("%d days in %s, seed %u, %.0f ms\n", days, getenv("TZ"),
+           (unsigned)seed,
+           ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e6);
+    printf("app launches: %u by the user, %u from quick launch, %u by wakeups\n",
+           user_launches, quick_launches, wakeup_launches);
+    printf("wakeup_schedule calls: %u, %u refused as too close, %u failed\n",
+           stub_wakeup_calls, stub_wakeup_refused, failed);
+    printf("other apps' wakeups: %u fired\n", foreign_fired);
+    printf("window starts: %u, %u with the worker stopped, %u missed\n",
+           starts, stopped_starts, missed);
+    printf("worker launches declined: %u\n", declined);
+    if (drifts)
+        printf("start wakeup drift: min %d s, avg %.1f s, max %d s over %u\n",
+               (int)drift_min, (double)drift_sum / drifts, (int)drift_max, drifts);
+    printf("start wakeups far from any window start: %u\n", stray);
+    printf("persist writes: %u\n", stub_persist_writes);
+    if (wakeup_launches)
+        printf("per wakeup launch: %.2f persist reads, %.2f writes, %.1f us\n",
+               (double)wake_reads / wakeup_launches,
+               (double)wake_writes / wakeup_launches,
+               wake_ns / wakeup_launches / 1e3);
+    printf("UI objects built: %u\n", stub_ui_created);
+    printf("our wakeups in use: at most %d of %d\n", max_slots, STUB_APP_WAKEUPS);
+    printf("schedule table mismatches: %u minutes\n", mismatches);
+
+    return(missed || mismatches ? 1 : 0);
+}
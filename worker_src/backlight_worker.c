@@ -1,24 +1,36 @@
 #include <pebble_worker.h>
-
-#define DURATION	6               /* copied from backlight.c */
-#define SAMPLES		7               /* copied from backlight.c */
-#define CHARGING	8
-#define PLUGGED		9
-#define AMBIENT		10
+#include "trace.h"
+#include "detector.h"
+#include "filter.h"
+#include "calibrate.h"
+#include "stats.h"
+#include "evlog.h"
+#include "usage.h"
+#include "../src/log.h"
+#include "../src/config.h"
 
 void light_enable_interaction(void);
 void light_enable(bool val);
 
 bool auto_backlight = false;
 bool light_on = false;
-time_t watch_level_start = 0;
+uint32_t dwell_ms = 500;                /* time level before light comes on */
 uint32_t time_duration=15;               /* default */
+uint32_t cfg_duration=15;               /* as set, before the battery policy */
 uint32_t samples=1;               /* default */
 bool charging=false;
 bool light_charging = false;            /* current have light on while charging */
 bool plugged=false;
 bool light_plugged = false;            /* current have light on while powered */
 bool ambient=false;
+bool tap_wake=false;                    /* accel data only after a tap */
+bool cfg_tap_wake=false;
+bool slow=false;                        /* battery policy: no bursts, big batches */
+bool cfg_raw=false;                     /* raw samples when nothing needs more */
+AppTimer *light_timer = NULL;           /* turns the light off */
+uint64_t light_extended = 0;            /* ms timestamp of last reschedule */
+bool asleep = false;                    /* outside the schedule */
+const Detector *detector = &box_detector;
 
 
 /*
@@ -36,27 +48,379 @@ backlight_enable (bool val)
 
 
 void
-light_callback (void *data) 
+light_off (void) 
 { 
 
+    if (light_timer) {
+        app_timer_cancel(light_timer);
+        light_timer = NULL;
+    }
     light_on = false;
     light_enable(false);
-    APP_LOG(APP_LOG_LEVEL_WARNING, "Light off\n");
+    stats_light_off();
+    usage_light_off();
+    trace_event(TRACE_EVENT_LIGHT_OFF);
+    evlog_add(EVLOG_LIGHT_OFF, 0);
+    LOG(APP_LOG_LEVEL_DEBUG, "Light off\n");
+}
+
+
+/*
+ * Sampling rate governor.
+ *
+ * Sampling at 10Hz all day is the main cost of running the worker, so
+ * the rate follows the motion of the wrist:
+ *
+ *   GOV_BURST	 a fast movement may be a raise: sample at GOV_BURST_RATE
+ *   GOV_NORMAL	 10Hz, batches of `samples` tenths of a second
+ *   GOV_STILL	 no movement for GOV_STILL_MS: 10Hz, batches of at least
+ *		 GOV_STILL_BATCH
+ *   GOV_TAP	 no movement for GOV_TAP_MS: accel data off, a tap wakes us
+ *
+ * In tap wake mode GOV_TAP is the resting state: accel data only runs for
+ * GOV_TAP_WINDOW_MS after a tap, extended by movement or a lit screen.
+ *
+ * Batch sizes scale with the rate so that a batch always covers the
+ * same time, keeping the configured responsiveness.
+ *
+ * While a trace is recorded there are no bursts: the trace format spaces
+ * samples by the one rate it was started at, and 25Hz samples would each
+ * need a sync record.
+ *
+ * With CONFIG_RAW_ACCEL the samples come from the raw data service: x, y
+ * and z only, 6 bytes a sample against 16, with one timestamp for the
+ * batch from which each sample's time is worked out.  There is no
+ * did_vibrate, so while a trace is recorded or a calibration runs, both
+ * of which want it, the full service is used whatever the setting.
+ */
+#define GOV_STILL_DELTA		60      /* mg change per sample; below is still */
+#define GOV_MOTION_DELTA	250     /* mg change per sample; above bursts */
+#define GOV_STILL_MS		(10 * 1000)
+#define GOV_TAP_MS		(5 * 60 * 1000)
+#define GOV_TAP_WINDOW_MS	3000
+#define GOV_BURST_MS		2000
+#define GOV_BURST_RATE		ACCEL_SAMPLING_25HZ
+#define GOV_STILL_BATCH		5
+#define GOV_MAX_BATCH		25      /* most the accel service will batch */
+
+typedef enum {
+    GOV_OFF,
+    GOV_TAP,
+    GOV_STILL,
+    GOV_NORMAL,
+    GOV_BURST,
+} GovState;
+
+GovState gov_state = GOV_OFF;
+bool gov_woken = false;                 /* tap seen, restart the clocks */
+uint64_t gov_last_motion = 0;
+uint64_t gov_burst_until = 0;
+int gov_delta = 0;                      /* most motion in this batch */
+AccelRawData gov_prev;                  /* last sample, for the motion */
+bool gov_primed = false;                /* gov_prev holds one */
+bool gov_resumed = false;               /* sampling restarted, idle from now */
+bool accel_raw = false;                 /* subscribed to raw samples */
+uint32_t accel_step_ms = 100;           /* between samples at the current rate */
+
+void handle_accel(AccelData *data, uint32_t num_samples);
+void handle_accel_raw(AccelRawData *data, uint32_t num_samples,
+                      uint64_t timestamp);
+void handle_tap(AccelAxisType axis, int32_t direction);
+
+void
+governor_set (GovState state) 
+{
+    AccelSamplingRate rate;
+    uint32_t batch;
+    bool raw = cfg_raw && !trace_active() && !calibrate_active();
+
+    if (state == gov_state && (state <= GOV_TAP || raw == accel_raw))
+        return;
+
+    if (gov_state == GOV_TAP) {
+        accel_tap_service_unsubscribe();
+    } else if (gov_state != GOV_OFF) {
+        accel_data_service_unsubscribe();
+    }
+
+    if (state == GOV_TAP) {
+        accel_tap_service_subscribe(handle_tap);
+    } else if (state != GOV_OFF) {
+        rate = (state == GOV_BURST) ? GOV_BURST_RATE : ACCEL_SAMPLING_10HZ;
+        batch = samples * rate / ACCEL_SAMPLING_10HZ;
+        /* still or slow: never smaller than GOV_STILL_BATCH */
+        if ((state == GOV_STILL || slow) && batch < GOV_STILL_BATCH)
+            batch = GOV_STILL_BATCH;
+        if (batch > GOV_MAX_BATCH)
+            batch = GOV_MAX_BATCH;
+        if (raw) {
+            accel_raw_data_service_subscribe(batch, handle_accel_raw);
+        } else {
+            accel_data_service_subscribe(batch, handle_accel);
+        }
+        accel_service_set_sampling_rate(rate);
+        accel_raw = raw;
+        accel_step_ms = 1000 / rate;
+        filter_set_step(accel_step_ms);
+        if (gov_state <= GOV_TAP) {
+            /* samples resume after a gap */
+            gov_primed = false;
+            gov_resumed = true;
+            filter_reset();
+            if (detector->reset)
+                detector->reset();
+        }
+    }
+
+    if (state != gov_state)
+        evlog_add(EVLOG_RATE, state);
+    gov_state = state;
+}
+
+
+void
+handle_tap (AccelAxisType axis, int32_t direction) 
+{
+
+    gov_woken = true;
+    governor_set(slow || trace_active() ? GOV_NORMAL : GOV_BURST);
+    if (detector->woken)
+        detector->woken();
+}
+
+
+/*
+ * Note how far the wrist moved since the last sample
+ */
+void
+governor_sample (const AccelRawData *s) 
+{
+    int d;
+
+    if (!gov_primed) {
+        /* the first sample after a gap has nothing to be measured from */
+        gov_prev = *s;
+        gov_primed = true;
+    }
+    d = abs(s->x - gov_prev.x) + abs(s->y - gov_prev.y) + abs(s->z - gov_prev.z);
+    if (d > gov_delta)
+        gov_delta = d;
+    gov_prev = *s;
+}
+
+/*
+ * Pick the sampling state from how much the wrist moved in the batch
+ * ending at `now`
+ */
+void
+governor_update (uint64_t now) 
+{
+    bool hold = light_on || calibrate_active(); /* keep sampling */
+    int max_delta = gov_delta;
+
+    gov_delta = 0;
+
+    if (gov_resumed) {
+        gov_resumed = false;
+        gov_last_motion = now;
+    }
+    if (gov_woken) {
+        gov_woken = false;
+        gov_last_motion = now;
+        gov_burst_until = now + GOV_BURST_MS;
+    }
+    if (max_delta >= GOV_STILL_DELTA)
+        gov_last_motion = now;
+    if (max_delta >= GOV_MOTION_DELTA && !hold)
+        gov_burst_until = now + GOV_BURST_MS;
+
+    if (light_charging || light_plugged) {
+        governor_set(GOV_STILL);
+    } else if (now < gov_burst_until && !hold && !slow && !trace_active()) {
+        governor_set(GOV_BURST);
+    } else if (now - gov_last_motion >=
+               (tap_wake ? GOV_TAP_WINDOW_MS : GOV_TAP_MS) && !hold) {
+        governor_set(GOV_TAP);
+    } else if (now - gov_last_motion >= GOV_STILL_MS) {
+        governor_set(GOV_STILL);
+    } else {
+        governor_set(GOV_NORMAL);
+    }
+}
+
+
+/*
+ * Gesture state machine.
+ *
+ * Every sample of a batch goes through the pre-filter (filter.h), is
+ * classified by the current detector and stepped through gesture_table;
+ * samples taken while the vibe motor ran are skipped, where the sample
+ * says so (raw samples don't).  A state with a timeout moves on once it
+ * has been held that long, measured in sample timestamps:
+ *
+ *   G_IDLE	 waiting for the viewing posture
+ *   G_CANDIDATE in the posture, waiting out dwell_ms
+ *   G_LIT	 light on; leaving the posture turns it off at once
+ *   G_SPENT	 light timed out while still held; leave to re-arm
+ *
+ * While lit and inside the posture the light-off timer keeps being pushed
+ * back, at most every G_EXTEND_MS, so the light lasts as long as the
+ * watch is looked at and time_duration only counts once it is not.
+ */
+#define G_EXTEND_MS	1000
+#define G_NO_TIMEOUT	UINT32_MAX
+
+typedef enum {
+    G_IDLE,
+    G_CANDIDATE,
+    G_LIT,
+    G_SPENT,
+    G_STATES
+} GestureState;
+
+typedef struct {
+    uint8_t next[POSTURE_CLASSES];      /* by Posture */
+    uint8_t on_timeout;
+} GestureRow;
+
+static const GestureRow gesture_table[G_STATES] = {
+    /*               outside     between      inside */
+    [G_IDLE]      = {{G_IDLE,     G_IDLE,      G_CANDIDATE}, G_IDLE},
+    [G_CANDIDATE] = {{G_IDLE,     G_CANDIDATE, G_CANDIDATE}, G_LIT},
+    [G_LIT]       = {{G_IDLE,     G_LIT,       G_LIT},       G_LIT},
+    [G_SPENT]     = {{G_IDLE,     G_SPENT,     G_SPENT},     G_SPENT},
+};
+
+GestureState gesture_state = G_IDLE;
+uint64_t gesture_since = 0;             /* ms timestamp state was entered */
+uint32_t gesture_timeout = G_NO_TIMEOUT;
+
+void light_callback(void *data);
+
+/*
+ * A raise held for dwell ms lights the light
+ */
+void
+light_up (uint32_t dwell) 
+{
+
+    if (ambient) {
+        backlight_enable(true);
+    } else {
+        light_enable(true);
+    }
+    light_on = true;
+    stats_light_on(STATS_ON_RAISE);
+    usage_light_on(STATS_ON_RAISE, dwell);
+    trace_event(TRACE_EVENT_LIGHT_ON);
+    evlog_add(EVLOG_LIGHT_ON, 0);
+    LOG(APP_LOG_LEVEL_DEBUG, "Light on\n");
+    if (time_duration) {
+        LOG(APP_LOG_LEVEL_DEBUG, "Scheduling light off, duration = %d\n", (int)time_duration);
+        if (light_timer == NULL ||
+            !app_timer_reschedule(light_timer, time_duration * 1000)) {
+            light_timer = app_timer_register(time_duration * 1000,
+                                             light_callback, NULL);
+        }
+    }
+}
+
+
+void
+gesture_enter (GestureState next, uint64_t ts) 
+{
+
+    if (next == G_LIT && gesture_state == G_CANDIDATE) {
+        light_up((uint32_t)(ts - gesture_since));
+        light_extended = ts;
+    } else if (next == G_IDLE && gesture_state == G_LIT && light_on) {
+        LOG(APP_LOG_LEVEL_DEBUG, "Turning light off\n");
+        light_off();
+    }
+
+    gesture_state = next;
+    gesture_since = ts;
+    switch (next) {
+    case G_CANDIDATE:
+        gesture_timeout = dwell_ms;
+        break;
+    default:
+        gesture_timeout = G_NO_TIMEOUT;
+        break;
+    }
+}
+
+
+/*
+ * Light duration is over
+ */
+void
+light_callback (void *data) 
+{
+
+    light_timer = NULL;
+    evlog_add(EVLOG_TIMEOUT, 0);
+    light_off();
+    if (gesture_state == G_LIT) {
+        gesture_enter(G_SPENT, gesture_since);
+    }
 }
 
 
-#define X_RANGE_LOW -250
-#define X_RANGE_HIGH 250
-#define Y_RANGE_LOW -1000
-#define Y_RANGE_HIGH -300
+/*
+ * Step one sample taken at ts through the pre-filter and the state machine
+ */
+Posture
+gesture_step (const AccelRawData *s, uint64_t ts) 
+{
+    AccelRawData f = *s;
+    Posture posture;
+    uint8_t next;
+
+    filter_sample(&f);
+    posture = detector->classify(&f, ts);
+    next = gesture_table[gesture_state].next[posture];
+    if (next != gesture_state)
+        gesture_enter(next, ts);
+
+    if (ts - gesture_since >= gesture_timeout)
+        gesture_enter(gesture_table[gesture_state].on_timeout, ts);
+    return(posture);
+}
+
+/*
+ * End of a batch whose last sample, taken at ts, was in `posture`.
+ * Still being looked at: push the light-off back.
+ */
+void
+gesture_batch_end (Posture posture, uint64_t ts) 
+{
+
+    if (gesture_state == G_LIT && posture == POSTURE_INSIDE && light_timer &&
+        ts - light_extended >= G_EXTEND_MS) {
+        light_extended = ts;
+        app_timer_reschedule(light_timer, time_duration * 1000);
+    }
+}
+
 
 void
 handle_accel(AccelData *data, uint32_t num_samples)
 {
-    static bool watch_outside_range = true;
-    static bool watch_on;
+    Posture posture = POSTURE_OUTSIDE;
+    AccelRawData s;
+    uint32_t i;
 
-    uint i;
+    if (num_samples == 0)
+        return;
+    stats_count(STATS_BATCHES);
+    trace_record(data, num_samples);
+    calibrate_feed(data, num_samples);
+    for (i = 0 ; i < num_samples ; i++) {
+        s = (AccelRawData){ data[i].x, data[i].y, data[i].z };
+        governor_sample(&s);
+    }
+    governor_update(data[num_samples - 1].timestamp);
 
     if (light_charging == true || light_plugged == true) {
         /* Don't bother, but leave the light on while charging or powered */
@@ -64,123 +428,388 @@ handle_accel(AccelData *data, uint32_t num_samples)
     }
 
     for (i = 0 ; i < num_samples ; i++) {
-        if (data[i].x < X_RANGE_HIGH && data[i].x > X_RANGE_LOW &&
-            data[i].y > Y_RANGE_LOW && data[i].y < Y_RANGE_HIGH) {
-            if (light_on == false &&
-                watch_level_start == 0 &&
-                watch_outside_range) {
-                watch_level_start = time(0L); /* record when level started */
-                watch_outside_range = false;
+        if (data[i].did_vibrate)
+            continue;
+        s = (AccelRawData){ data[i].x, data[i].y, data[i].z };
+        posture = gesture_step(&s, data[i].timestamp);
+    }
+    gesture_batch_end(posture, data[num_samples - 1].timestamp);
+}
+
+/*
+ * The same for raw samples: `timestamp` is the first sample's, the rest
+ * follow at the sampling rate the batch was subscribed with.
+ */
+void
+handle_accel_raw (AccelRawData *data, uint32_t num_samples, uint64_t timestamp) 
+{
+    Posture posture = POSTURE_OUTSIDE;
+    uint32_t step = accel_step_ms;      /* before governor_update() changes it */
+    uint64_t last;
+    uint64_t ts;
+    uint32_t i;
+
+    if (num_samples == 0)
+        return;
+    last = timestamp + (uint64_t)(num_samples - 1) * step;
+    stats_count(STATS_BATCHES);
+    for (i = 0 ; i < num_samples ; i++)
+        governor_sample(&data[i]);
+    governor_update(last);
+
+    if (light_charging == true || light_plugged == true)
+        return;
+
+    for (i = 0, ts = timestamp ; i < num_samples ; i++, ts += step)
+        posture = gesture_step(&data[i], ts);
+    gesture_batch_end(posture, last);
+}
+
+
+
+/*
+ * Battery policy.
+ *
+ * The battery is always watched, and as it runs down the worker gives up
+ * responsiveness to make the rest of the charge last.  The first row
+ * whose level the charge is below applies:
+ *
+ *   duration	cap on the light-on time, seconds, 0 = no cap
+ *   POLICY_SLOW	no bursts above 10Hz, the lowest accel rate, and
+ *			batches as large as when still, so fewer wakeups
+ *   POLICY_TAP	tap wake mode whatever the setting
+ *
+ * No row applies while plugged in or with CONFIG_NO_SAVER set.
+ */
+#define POLICY_SLOW	0x01
+#define POLICY_TAP	0x02
+
+typedef struct {
+    uint8_t below;                      /* charge percent */
+    uint8_t duration;
+    uint8_t flags;
+} PolicyRow;
+
+static const PolicyRow battery_policy[] = {
+    { 10, 3, POLICY_SLOW | POLICY_TAP },
+    { 20, 3, POLICY_SLOW },
+    { 30, 3, 0 },
+};
+
+bool saver = true;
+const PolicyRow *policy = NULL;
+
+void governor_start(void);
+
+void
+policy_apply (void) 
+{
+    bool was_slow = slow, was_tap = tap_wake;
+
+    time_duration = cfg_duration;
+    tap_wake = cfg_tap_wake;
+    slow = false;
+    if (policy) {
+        if (policy->duration &&
+            (time_duration == 0 || time_duration > policy->duration))
+            time_duration = policy->duration;
+        slow = (policy->flags & POLICY_SLOW) != 0;
+        tap_wake |= (policy->flags & POLICY_TAP) != 0;
+    }
+
+    if (!asleep && (slow != was_slow || tap_wake != was_tap))
+        governor_start();
+}
+
+void
+policy_update (BatteryChargeState charge) 
+{
+    const PolicyRow *row = NULL;
+    uint8_t i;
+
+    if (saver && !charge.is_plugged) {
+        for (i = 0 ; i < ARRAY_LENGTH(battery_policy) ; i++) {
+            if (charge.charge_percent < battery_policy[i].below) {
+                row = &battery_policy[i];
                 break;
             }
-        } else if ((data[i].x > (X_RANGE_HIGH + 50) || data[i].x < (X_RANGE_LOW - 50)) ||
-                   (data[i].y < (Y_RANGE_LOW - 100) || data[i].y > (Y_RANGE_HIGH + 100))) {
-            watch_level_start = 0;
-            watch_outside_range = true;
-            if (/* time_duration == 0 */ (time(0L) - watch_level_start > 1) && light_on) {
-                APP_LOG(APP_LOG_LEVEL_WARNING, "Turning light off\n");
-                light_callback(NULL);
-            }
-            break;
         }
     }
-    
-    /*
-     * If new state is "off", do this now
-     */
-    if (watch_level_start != 0 && (time(0L) - watch_level_start) > 0) {
-        if (ambient) {
-            backlight_enable(true);
-        } else {
-            light_enable(true);
-        }
-	light_on = true;
-        APP_LOG(APP_LOG_LEVEL_WARNING, "Light on\n");
-        if (time_duration) {
-            APP_LOG(APP_LOG_LEVEL_WARNING, "Scheduling light off, duration = %d\n", (int)time_duration);
-            app_timer_register(time_duration * 1000, light_callback, NULL);
-        }
-	watch_level_start = 0;
-    }
-}
+    if (row == policy)
+        return;
 
+    policy = row;
+    evlog_add(EVLOG_POLICY, row ? row->below : 0);
+    policy_apply();
+}
 
 
+/*
+ * Called on every change of the charge percent, and with each settings
+ * reload, so the light is only turned on, and counted, when the reason
+ * for it is new.
+ */
 void
 battery_handler (BatteryChargeState charge) 
 {
 
+    policy_update(charge);
+    if (asleep)
+        return;
+
     if (charge.is_charging && charging) {
-        APP_LOG(APP_LOG_LEVEL_WARNING, "Charging and lit\n");
+        if (light_charging)
+            return;
+        LOG(APP_LOG_LEVEL_DEBUG, "Charging and lit\n");
+        if (light_timer) {
+            app_timer_cancel(light_timer);
+            light_timer = NULL;
+        }
         light_enable(true);
         light_charging = true;
+        light_plugged = false;
         light_on = true;
+        stats_light_on(STATS_ON_CHARGING);
+        usage_light_on(STATS_ON_CHARGING, 0);
+        trace_event(TRACE_EVENT_CHARGING_ON);
+        evlog_add(EVLOG_CHARGING, charge.charge_percent);
     } else if (charge.is_plugged && plugged) {
-        APP_LOG(APP_LOG_LEVEL_WARNING, "Plugged in and lit\n");
+        if (light_plugged)
+            return;
+        LOG(APP_LOG_LEVEL_DEBUG, "Plugged in and lit\n");
+        if (light_timer) {
+            app_timer_cancel(light_timer);
+            light_timer = NULL;
+        }
         light_enable(true);
         light_plugged = true;
+        light_charging = false;
         light_on = true;
-    } else {
-        APP_LOG(APP_LOG_LEVEL_WARNING, "Not lit\n");
+        stats_light_on(STATS_ON_PLUGGED);
+        usage_light_on(STATS_ON_PLUGGED, 0);
+        trace_event(TRACE_EVENT_PLUGGED_ON);
+        evlog_add(EVLOG_PLUGGED, charge.charge_percent);
+    } else if (light_charging || light_plugged) {
+        LOG(APP_LOG_LEVEL_DEBUG, "Not lit\n");
+        evlog_add(EVLOG_UNPLUGGED, charge.charge_percent);
         light_charging = false;
         light_plugged = false;
         if (light_on == true) {
-            light_enable(false);
-            light_on = false;
+            light_off();
         }
     }
 }
 
 
 
-int main(void) {
-    uint32_t	val;
+/*
+ * Schedule.
+ *
+ * The worker runs all the time and follows the schedule itself: outside
+ * its windows it sleeps with the accelerometer off, battery events
+ * ignored and only a timer for the next edge left running, so no app launch is
+ * needed at either end of a window.  The app only books a wakeup when
+ * the worker is not running.
+ *
+ * The timer is capped at SCHED_RECHECK_MS so a change of the clock or
+ * time zone is picked up within the hour.
+ *
+ * Turned on by hand outside a window, the worker stays awake until the
+ * next window starts: the app puts that time in the settings record
+ * before it launches the worker or sends WORKER_CONFIG.
+ */
+#define SCHED_RECHECK_MS	(60 * 60 * 1000)
 
-    val = persist_read_int(DURATION);
-    time_duration = (int)val;
-    APP_LOG(APP_LOG_LEVEL_WARNING, "time_duration=%u", (uint)val);
+SchedTable sched_table;
+bool sched_limited = false;             /* a schedule is set */
+AppTimer *sched_timer = NULL;
+time_t awake_until = 0;                 /* turned on by hand */
 
-    val = persist_read_int(SAMPLES);
-    if (val) {
-	samples = (int)val;
-    } else {
-        samples = 1;              /* default */
-    }
-    APP_LOG(APP_LOG_LEVEL_WARNING, "samples=%u", (uint)val);
+void
+governor_start (void) 
+{
 
-    accel_service_set_sampling_rate(ACCEL_SAMPLING_10HZ);
-    accel_data_service_subscribe(samples, handle_accel);
-    auto_backlight = true;
+    /* (re)subscribe for the batch size */
+    governor_set(GOV_OFF);
+    governor_set(tap_wake ? GOV_TAP : GOV_NORMAL);
+}
 
-    val = persist_read_bool(CHARGING);
-    if (val) {
-	charging = (bool)val;
-    } else {
-        charging = false;              /* default */
+void
+schedule_sleep (void) 
+{
+
+    asleep = true;
+    governor_set(GOV_OFF);
+    light_charging = false;
+    light_plugged = false;
+    if (light_on)
+        light_off();
+    gesture_state = G_IDLE;
+    gesture_timeout = G_NO_TIMEOUT;
+    evlog_add(EVLOG_SLEEP, 0);
+}
+
+void
+schedule_wake (void) 
+{
+
+    asleep = false;
+    governor_start();
+    battery_handler(battery_state_service_peek());
+    evlog_add(EVLOG_WAKE, 0);
+}
+
+void schedule_timer(void *data);
+
+void
+schedule_check (void) 
+{
+    time_t now = time(0L);
+    time_t next;
+    bool active;
+    uint32_t ms = SCHED_RECHECK_MS;
+
+    if (sched_timer) {
+        app_timer_cancel(sched_timer);
+        sched_timer = NULL;
     }
-    APP_LOG(APP_LOG_LEVEL_WARNING, "light when charging = %u",
-            (uint)val);
 
-    val = persist_read_bool(PLUGGED);
-    if (val) {
-	plugged = (bool)val;
+    active = !sched_limited || now < awake_until ||
+        schedule_active(&sched_table, now);
+    if (active && asleep) {
+        schedule_wake();
+    } else if (!active && !asleep) {
+        schedule_sleep();
+    }
+
+    if (!sched_limited)
+        return;
+
+    next = (now < awake_until) ? awake_until :
+        schedule_next_time(&sched_table, now, !active);
+    if (next && (uint32_t)(next - now) < SCHED_RECHECK_MS / 1000)
+        ms = (uint32_t)(next - now) * 1000;
+    sched_timer = app_timer_register(ms, schedule_timer, NULL);
+}
+
+void
+schedule_timer (void *data) 
+{
+
+    sched_timer = NULL;
+    schedule_check();
+}
+
+
+/*
+ * Take on a settings record, at startup or when the app says it changed
+ */
+void
+apply_settings (const Settings *s)
+{
+
+    cfg_duration = s->duration;
+    samples = s->samples ? s->samples : 1;
+    dwell_ms = s->dwell * 100;
+    charging = (s->flags & CONFIG_CHARGING) != 0;
+    plugged = (s->flags & CONFIG_PLUGGED) != 0;
+    ambient = (s->flags & CONFIG_AMBIENT) != 0;
+    cfg_tap_wake = (s->flags & CONFIG_TAP_WAKE) != 0;
+    saver = (s->flags & CONFIG_NO_SAVER) == 0;
+    cfg_raw = (s->flags & CONFIG_RAW_ACCEL) != 0;
+    detector = detector_for_profile(s->profile, s->detector);
+    LOG(APP_LOG_LEVEL_DEBUG, "settings: duration=%u samples=%u dwell_ms=%u flags=%x",
+        (uint)cfg_duration, (uint)samples, (uint)dwell_ms, (uint)s->flags);
+    /* before the governor, which picks raw or full samples by it */
+    if (s->flags & CONFIG_TRACE) {
+        trace_start(ACCEL_SAMPLING_10HZ);
     } else {
-        plugged = false;              /* default */
+        trace_stop();
     }
-    APP_LOG(APP_LOG_LEVEL_WARNING, "light when plugged = %u",
-            (uint)val);
 
-    val = persist_read_bool(AMBIENT);
-    if (val) {
-	ambient = (bool)val;
+    policy_apply();
+
+    if (!asleep)
+        governor_start();
+    auto_backlight = true;
+
+    if (s->flags & CONFIG_USAGE) {
+        usage_start();
     } else {
-        ambient = false;              /* default */
+        usage_stop();
     }
-    APP_LOG(APP_LOG_LEVEL_WARNING, "ambient=%u", (uint)val);
 
-    if (charging || plugged) {
-        battery_state_service_subscribe(battery_handler);
+    /* always: the battery policy follows the charge level */
+    battery_state_service_subscribe(battery_handler);
+    battery_handler(battery_state_service_peek());
+
+    schedule_compile(&s->schedule, &sched_table);
+    sched_limited = !schedule_empty(&s->schedule);
+    awake_until = (time_t)s->awake_until;
+    schedule_check();
+}
+
+
+/*
+ * Requests from the foreground app
+ */
+void
+worker_message_handler (uint16_t type, AppWorkerMessage *data)
+{
+    Settings settings;
+
+    switch (type) {
+    case WORKER_DUMP_TRACE:
+        if (trace_active()) {
+            trace_dump_log();
+        } else {
+            LOG(APP_LOG_LEVEL_WARNING, "Not recording a trace");
+        }
+        break;
+
+    case WORKER_DUMP_LOG:
+        evlog_send(WORKER_DUMP_LOG);
+        break;
+
+    case WORKER_STATS:
+        stats_send(WORKER_STATS);
+        break;
+
+    case WORKER_CONFIG:
+        settings_load(&settings);
+        apply_settings(&settings);
+        break;
+
+    case WORKER_CALIBRATE:
+        if (asleep) {
+            evlog_add(EVLOG_CALIBRATED, 0);
+            break;
+        }
+        calibrate_start();
+        if (gov_state == GOV_TAP) {
+            governor_set(GOV_NORMAL);
+        } else {
+            governor_set(gov_state);    /* onto full samples */
+        }
+        break;
     }
+}
+
+
+
+int main(void) {
+    Settings settings;
+
+    evlog_init();
+    evlog_add(EVLOG_START, 0);
+    stats_init();
+
+    box_load();
+    settings_load(&settings);
+    apply_settings(&settings);
+    app_worker_message_subscribe(worker_message_handler);
 
     worker_event_loop();
+    usage_flush();
+    return 0;
 }
@@ -0,0 +1,220 @@
+#include <pebble_worker.h>
+#include "calibrate.h"
+#include "detector.h"
+#include "evlog.h"
+#include "../src/log.h"
+#include "../src/config.h"
+
+void light_enable_interaction(void);
+
+#define CAL_MOTION_DELTA	250     /* mg change per sample; a raise */
+#define CAL_HOLD_RANGE		150     /* mg per axis from the start of a hold */
+#define CAL_RAISE_MS		2000    /* hold must start this soon after motion */
+#define CAL_SETTLE_MS		300     /* hold time before samples are taken */
+#define CAL_TAKE_MS		600    /* samples taken per raise */
+#define CAL_TIMEOUT_MS		(3 * 60 * 1000)
+
+/* Loose bounds on a hold to count as looking at the watch at all */
+#define CAL_GATE_X		600
+#define CAL_GATE_Y_LOW		-1100
+#define CAL_GATE_Y_HIGH		-300
+
+#define CAL_K			3       /* box half width, in standard deviations */
+#define CAL_MIN_HALF		120     /* mg, x and y */
+#define CAL_MIN_HALF_Z		250     /* mg; z matters least */
+#define CAL_MIN_MARGIN		50
+#define CAL_LIMIT		1500    /* mg; keep the box on the scale */
+
+/*
+ * Welford's running mean and variance, in fixed point: mean is in
+ * 1/16 mg, m2 in 1/256 mg^2.
+ */
+typedef struct {
+    int32_t mean;
+    int64_t m2;
+} CalAxis;
+
+static bool active = false;
+static uint8_t raises;
+static uint32_t count;
+static CalAxis axis[3];
+
+static uint64_t started;                /* ms timestamps */
+static uint64_t last_motion;
+static uint64_t hold_start;             /* 0 = not holding */
+static AccelData anchor;                /* first sample of the hold */
+static bool taken;                      /* this hold already used */
+static int16_t px, py, pz;              /* previous sample */
+static bool primed;                     /* px, py, pz hold one */
+
+
+bool
+calibrate_active (void)
+{
+    return(active);
+}
+
+
+void
+calibrate_start (void)
+{
+
+    memset(axis, 0, sizeof(axis));
+    count = 0;
+    raises = 0;
+    started = 0;
+    last_motion = 0;
+    hold_start = 0;
+    taken = true;                       /* wait for a movement first */
+    primed = false;
+    active = true;
+    evlog_add(EVLOG_CAL_RAISE, 0);
+}
+
+
+static void
+add_sample (const AccelData *s)
+{
+    const int16_t v[3] = { s->x, s->y, s->z };
+    int32_t d;
+    int i;
+
+    count++;
+    for (i = 0 ; i < 3 ; i++) {
+        d = ((int32_t)v[i] << 4) - axis[i].mean;
+        axis[i].mean += d / (int32_t)count;
+        axis[i].m2 += (int64_t)d * (((int32_t)v[i] << 4) - axis[i].mean);
+    }
+}
+
+
+static uint32_t
+isqrt (uint64_t v)
+{
+    uint64_t r = 0, bit = (uint64_t)1 << 62;
+
+    while (bit > v)
+        bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return((uint32_t)r);
+}
+
+
+static int16_t
+clamp (int v)
+{
+
+    if (v < -CAL_LIMIT)
+        return(-CAL_LIMIT);
+    if (v > CAL_LIMIT)
+        return(CAL_LIMIT);
+    return((int16_t)v);
+}
+
+
+static void
+finish (void)
+{
+    Box b;
+    int i, mean, sd, half;
+
+    box_default(&b);
+    for (i = 0 ; i < 3 ; i++) {
+        mean = axis[i].mean / 16;
+        sd = (int)isqrt((uint64_t)(axis[i].m2 / (count - 1))) / 16;
+        half = CAL_K * sd;
+        if (half < (i == 2 ? CAL_MIN_HALF_Z : CAL_MIN_HALF))
+            half = (i == 2) ? CAL_MIN_HALF_Z : CAL_MIN_HALF;
+        b.low[i] = clamp(mean - half);
+        b.high[i] = clamp(mean + half);
+        b.margin[i] = (sd > CAL_MIN_MARGIN) ? sd : CAL_MIN_MARGIN;
+        LOG(APP_LOG_LEVEL_DEBUG, "calibrate axis %d: mean %d sd %d", i, mean, sd);
+    }
+
+    box_set(&b);
+    persist_write_data(CALIBRATION_KEY, &b, sizeof(b));
+    evlog_add(EVLOG_CALIBRATED, raises);
+    active = false;
+}
+
+
+void
+calibrate_feed (AccelData *data, uint32_t num_samples)
+{
+    const AccelData *s;
+    uint64_t held;
+    int d;
+    uint32_t i;
+
+    if (!active || num_samples == 0)
+        return;
+    /* from the first batch, even one taken while the motor ran */
+    if (started == 0)
+        started = data[0].timestamp;
+
+    for (i = 0 ; i < num_samples ; i++) {
+        s = &data[i];
+        if (s->did_vibrate)
+            continue;
+        if (!primed) {
+            px = s->x;
+            py = s->y;
+            pz = s->z;
+            primed = true;
+        }
+
+        d = abs(s->x - px) + abs(s->y - py) + abs(s->z - pz);
+        px = s->x;
+        py = s->y;
+        pz = s->z;
+
+        if (d >= CAL_MOTION_DELTA) {
+            last_motion = s->timestamp;
+            hold_start = 0;
+            taken = false;
+        } else if (abs(s->x) > CAL_GATE_X ||
+                   s->y < CAL_GATE_Y_LOW || s->y > CAL_GATE_Y_HIGH) {
+            hold_start = 0;
+        } else if (!taken) {
+            if (hold_start == 0 ||
+                abs(s->x - anchor.x) > CAL_HOLD_RANGE ||
+                abs(s->y - anchor.y) > CAL_HOLD_RANGE ||
+                abs(s->z - anchor.z) > CAL_HOLD_RANGE) {
+                /* only a hold that follows a movement is a raise */
+                if (s->timestamp - last_motion > CAL_RAISE_MS) {
+                    taken = true;
+                    continue;
+                }
+                anchor = *s;
+                hold_start = s->timestamp;
+            }
+            held = s->timestamp - hold_start;
+            if (held >= CAL_SETTLE_MS)
+                add_sample(s);
+            if (held >= CAL_SETTLE_MS + CAL_TAKE_MS) {
+                taken = true;
+                raises++;
+                evlog_add(EVLOG_CAL_RAISE, raises);
+                light_enable_interaction();     /* got it */
+                if (raises == CAL_RAISES) {
+                    finish();
+                    return;
+                }
+            }
+        }
+    }
+
+    if (data[num_samples - 1].timestamp - started > CAL_TIMEOUT_MS) {
+        LOG(APP_LOG_LEVEL_WARNING, "calibration gave up after %u raises", raises);
+        evlog_add(EVLOG_CALIBRATED, 0);
+        active = false;
+    }
+}
@@ -0,0 +1,18 @@
+/*
+ * Calibration of the box detector to the wearer.
+ *
+ * While calibrating, the worker looks for CAL_RAISES deliberate raises:
+ * a movement followed by the wrist being held still, roughly facing the
+ * wearer.  The samples of
+ * each hold go into a fixed-point running mean and variance per axis,
+ * and the posture box is set to the mean plus or minus a few standard
+ * deviations, then persisted under CALIBRATION_KEY.  The light flashes
+ * as each raise is taken.
+ */
+#pragma once
+
+#include <pebble_worker.h>
+
+void calibrate_start(void);
+bool calibrate_active(void);
+void calibrate_feed(AccelData *data, uint32_t num_samples);
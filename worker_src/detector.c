@@ -0,0 +1,328 @@
+#include <pebble_worker.h>
+#include "detector.h"
+#include "../src/log.h"
+#include "../src/config.h"
+
+/*
+ * The original detector: an x/y box for a watch worn on the left wrist,
+ * face up, with a wider box around it for hysteresis.  The defaults are
+ * the original fixed box with z left open; calibration replaces them
+ * with one fitted to the wearer.
+ */
+#define X_RANGE_LOW -250
+#define X_RANGE_HIGH 250
+#define Y_RANGE_LOW -1000
+#define Y_RANGE_HIGH -300
+#define Z_RANGE_LOW -4000               /* beyond any reading: unused */
+#define Z_RANGE_HIGH 4000
+#define X_MARGIN 50
+#define Y_MARGIN 100
+
+static Box box;
+
+static void raise_aim_box(void);
+
+void
+box_default (Box *b)
+{
+
+    b->version = BOX_VERSION;
+    b->low[0] = X_RANGE_LOW;
+    b->high[0] = X_RANGE_HIGH;
+    b->margin[0] = X_MARGIN;
+    b->low[1] = Y_RANGE_LOW;
+    b->high[1] = Y_RANGE_HIGH;
+    b->margin[1] = Y_MARGIN;
+    b->low[2] = Z_RANGE_LOW;
+    b->high[2] = Z_RANGE_HIGH;
+    b->margin[2] = 0;
+}
+
+
+void
+box_set (const Box *b)
+{
+
+    box = *b;
+    raise_aim_box();
+    LOG(APP_LOG_LEVEL_DEBUG, "box x %d..%d y %d..%d z %d..%d",
+        box.low[0], box.high[0], box.low[1], box.high[1],
+        box.low[2], box.high[2]);
+}
+
+
+/*
+ * Use the calibrated box if there is one
+ */
+void
+box_load (void)
+{
+    Box b;
+
+    if (persist_read_data(CALIBRATION_KEY, &b, sizeof(b)) != (int)sizeof(b) ||
+        b.version != BOX_VERSION)
+        box_default(&b);
+    box_set(&b);
+}
+
+
+static Posture
+box_classify (const AccelRawData *s, uint64_t ts)
+{
+    const int16_t v[3] = { s->x, s->y, s->z };
+    Posture p = POSTURE_INSIDE;
+    int i;
+
+    for (i = 0 ; i < 3 ; i++) {
+        if (v[i] < box.low[i] - box.margin[i] ||
+            v[i] > box.high[i] + box.margin[i])
+            return(POSTURE_OUTSIDE);
+        if (v[i] <= box.low[i] || v[i] >= box.high[i])
+            p = POSTURE_BETWEEN;
+    }
+    return(p);
+}
+
+const Detector box_detector = {
+    .name = "box",
+    .reset = NULL,
+    .woken = NULL,
+    .classify = box_classify,
+};
+
+
+/*
+ * Reference directions in mg, about 1g long, for each PROFILE_*.
+ * Worn normally the crown points at the hand on the left wrist and at
+ * the elbow on the right, so x tips the other way when the forearm is
+ * raised; worn inverted, with the face on the inside of the wrist, 12
+ * o'clock points toward the body when the face is turned to the eyes.
+ */
+static const int16_t cone_refs[PROFILES][3] = {
+    [PROFILE_LEFT] = { -100, -640, -760 },
+    [PROFILE_RIGHT] = { 100, -640, -760 },
+    [PROFILE_LEFT_INVERTED] = { -100, 640, -760 },
+    [PROFILE_RIGHT_INVERTED] = { 100, 640, -760 },
+};
+
+#define CONE_MIN_MAG2		(300 * 300)     /* mg^2; direction too unsure */
+
+static const int16_t *cone_ref = cone_refs[PROFILE_LEFT];
+static int32_t cone_ref_mag2;
+
+
+/*
+ * cos^2 of the angle is dot^2 / (|v|^2 |r|^2), so compare
+ * dot^2 * 1024 with cos2 * |v|^2 * |r|^2 and never take a root.
+ */
+static Posture
+cone_classify (const AccelRawData *s, uint64_t ts)
+{
+    int32_t dot, mag2;
+    int64_t lhs, rhs;
+
+    dot = s->x * cone_ref[0] + s->y * cone_ref[1] + s->z * cone_ref[2];
+    mag2 = s->x * s->x + s->y * s->y + s->z * s->z;
+    if (mag2 < CONE_MIN_MAG2)
+        return(POSTURE_BETWEEN);
+    if (dot <= 0)
+        return(POSTURE_OUTSIDE);
+
+    lhs = (int64_t)dot * dot * 1024;
+    rhs = (int64_t)mag2 * cone_ref_mag2;
+    if (lhs >= rhs * CONE_COS2_INSIDE)
+        return(POSTURE_INSIDE);
+    if (lhs < rhs * CONE_COS2_OUTSIDE)
+        return(POSTURE_OUTSIDE);
+    return(POSTURE_BETWEEN);
+}
+
+const Detector cone_detector = {
+    .name = "cone",
+    .reset = NULL,
+    .woken = NULL,
+    .classify = cone_classify,
+};
+
+
+/*
+ * The raise detector, on top of the box or the cone
+ */
+static const Detector *raise_base = &box_detector;
+static int32_t raise_dir[3];            /* viewing direction, 1/1024 units */
+static int16_t facing[RAISE_SAMPLES];   /* ring: mg along raise_dir */
+static uint32_t facing_ts[RAISE_SAMPLES];       /* ms, low bits */
+static uint8_t facing_next;
+static uint8_t facing_count;
+static bool raised;                     /* in view after a raise */
+static bool woken;                      /* the ring restarted at a tap */
+static uint32_t woken_ts;               /* its first sample, ms, low bits */
+
+
+static uint32_t
+isqrt (uint32_t n)
+{
+    uint32_t root = 0, bit = 1UL << 30;
+
+    while (bit > n)
+        bit >>= 2;
+    while (bit) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return(root);
+}
+
+/*
+ * Point raise_dir along v, which must not be zero
+ */
+static void
+raise_set_dir (const int16_t *v)
+{
+    uint32_t mag;
+    int i;
+
+    mag = isqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (i = 0 ; i < 3 ; i++)
+        raise_dir[i] = v[i] * 1024 / (int32_t)mag;
+}
+
+/*
+ * The box moved, by calibration: look along its middle
+ */
+static void
+raise_aim_box (void)
+{
+    int16_t mid[3];
+    int i;
+
+    for (i = 0 ; i < 3 ; i++)
+        mid[i] = (box.low[i] + box.high[i]) / 2;
+    if (raise_base == &box_detector && (mid[0] || mid[1] || mid[2]))
+        raise_set_dir(mid);
+}
+
+static void
+raise_reset (void)
+{
+
+    facing_next = 0;
+    facing_count = 0;
+    raised = false;
+    woken = false;
+}
+
+static void
+raise_woken (void)
+{
+
+    woken = true;
+}
+
+/*
+ * Did the wrist turn toward the viewing direction over the ring, ending
+ * at the newest sample?  Walk back from it while nothing on the way
+ * drops by more than RAISE_DROP_MG, looking for the climb.
+ */
+static bool
+raise_seen (void)
+{
+    uint8_t i, k, steps;
+    int16_t now, prev, low;
+    uint32_t now_ts;
+
+    i = (facing_next + RAISE_SAMPLES - 1) % RAISE_SAMPLES;
+    now = low = facing[i];
+    now_ts = facing_ts[i];
+    for (steps = 1 ; steps < facing_count ; steps++) {
+        k = (i + RAISE_SAMPLES - 1) % RAISE_SAMPLES;
+        if (now_ts - facing_ts[k] > RAISE_MS)
+            break;
+        prev = facing[k];
+        if (prev - facing[i] > RAISE_DROP_MG)
+            return(false);              /* fell on the way up */
+        if (prev < low)
+            low = prev;
+        if (steps >= RAISE_MIN_STEPS && now - low >= RAISE_RISE_MG)
+            return(true);
+        i = k;
+    }
+    return(false);
+}
+
+static Posture
+raise_classify (const AccelRawData *s, uint64_t ts)
+{
+    Posture p;
+
+    facing[facing_next] = (int16_t)((s->x * raise_dir[0] + s->y * raise_dir[1] +
+                                     s->z * raise_dir[2]) / 1024);
+    facing_ts[facing_next] = (uint32_t)ts;
+    facing_next = (facing_next + 1) % RAISE_SAMPLES;
+    if (facing_count < RAISE_SAMPLES)
+        facing_count++;
+
+    /* after a tap the raise may be over before the ring has it */
+    if (woken && facing_count == 1)
+        woken_ts = (uint32_t)ts;
+    if (woken && (uint32_t)ts - woken_ts > RAISE_MS)
+        woken = false;
+
+    p = raise_base->classify(s, ts);
+    if (p == POSTURE_OUTSIDE) {
+        raised = false;
+        woken = false;
+    } else if (p == POSTURE_INSIDE && !raised) {
+        raised = woken || raise_seen();
+        woken = false;
+        if (!raised)
+            p = POSTURE_BETWEEN;
+    }
+    return(p);
+}
+
+const Detector raise_detector = {
+    .name = "raise",
+    .reset = raise_reset,
+    .woken = raise_woken,
+    .classify = raise_classify,
+};
+
+
+/*
+ * PROFILE_BOX, and anything unknown, uses the (calibrated) box.  With
+ * DETECTOR_RAISE that is wrapped in the raise detector, looking along
+ * the middle of the box or the cone's reference.
+ */
+const Detector *
+detector_for_profile (uint8_t profile, uint8_t kind)
+{
+    const Detector *d;
+
+    if (profile == PROFILE_BOX || profile >= PROFILES) {
+        d = &box_detector;
+    } else {
+        cone_ref = cone_refs[profile];
+        cone_ref_mag2 = cone_ref[0] * cone_ref[0] + cone_ref[1] * cone_ref[1] +
+            cone_ref[2] * cone_ref[2];
+        LOG(APP_LOG_LEVEL_DEBUG, "cone profile %u", (uint)profile);
+        d = &cone_detector;
+    }
+    if (kind != DETECTOR_RAISE)
+        return(d);
+
+    raise_base = d;
+    if (d == &box_detector) {
+        raise_aim_box();
+    } else {
+        raise_set_dir(cone_ref);
+    }
+    raise_reset();
+    LOG(APP_LOG_LEVEL_DEBUG, "raise detector on %s", d->name);
+    return(&raise_detector);
+}
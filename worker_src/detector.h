@@ -0,0 +1,88 @@
+/*
+ * Posture detectors for the backlight worker.
+ *
+ * A detector sorts each accelerometer sample into one of three classes,
+ * which drive the gesture state machine in backlight_worker.c.  The
+ * BETWEEN class is the hysteresis band: it neither starts nor ends a
+ * raise, so a sample wobbling on the edge of the viewing posture does
+ * not flicker the light.  Detectors only look at x, y and z, so they
+ * serve the raw sample pipeline as well as the full one.
+ */
+#pragma once
+
+#include <pebble_worker.h>
+
+typedef enum {
+    POSTURE_OUTSIDE,
+    POSTURE_BETWEEN,
+    POSTURE_INSIDE,
+    POSTURE_CLASSES
+} Posture;
+
+typedef struct {
+    const char *name;
+    void (*reset)(void);                /* may be NULL */
+    void (*woken)(void);                /* after reset, for a tap; may be NULL */
+    Posture (*classify)(const AccelRawData *sample, uint64_t ts);   /* ts in ms */
+} Detector;
+
+/*
+ * The box detector's viewing posture, per axis x, y, z in mg: inside is
+ * strictly between low and high, outside is beyond them by more than
+ * margin.  It is persisted as is under CALIBRATION_KEY by calibrate.c.
+ */
+#define BOX_VERSION	1
+
+typedef struct __attribute__((__packed__)) {
+    uint8_t version;
+    int16_t low[3];
+    int16_t high[3];
+    int16_t margin[3];
+} Box;
+
+extern const Detector box_detector;
+
+void box_default(Box *b);
+void box_set(const Box *b);
+void box_load(void);
+
+/*
+ * The cone detector: the angle between the sample and a reference
+ * viewing direction for the way the watch is worn (PROFILE_* in
+ * src/config.h), tested with integer dot products.  Inside is within
+ * 20 degrees of the reference, outside beyond 30.  The limits are the
+ * squared cosines of those angles, in 1/1024, so no angle or root is
+ * ever worked out: round(1024 * cos(a)^2) for another angle a.
+ */
+#define CONE_COS2_INSIDE	904     /* 20 degrees */
+#define CONE_COS2_OUTSIDE	768     /* 30 degrees */
+
+extern const Detector cone_detector;
+
+/*
+ * The raise detector (DETECTOR_RAISE): the profile's posture detector
+ * decides where the viewing posture is, but entering it only counts as
+ * INSIDE after a raise into it.  A ring of the last RAISE_SAMPLES
+ * samples' components along the viewing direction, with their times, is
+ * kept across batches; a raise is that component climbing by
+ * RAISE_RISE_MG within RAISE_MS to the current sample, from one at least
+ * RAISE_MIN_STEPS samples back, with no drop of more than RAISE_DROP_MG
+ * on the way.  Settling slowly into the posture, as when lying down,
+ * is too slow to count.  Once seen it holds
+ * until the posture detector says OUTSIDE, so keeping the watch in
+ * view keeps the light on.  Holding the posture without the raise, as
+ * when reading in bed or steering, is BETWEEN and lights nothing.
+ *
+ * With tap wake the ring starts at the tap, usually after the raise it
+ * was meant to follow, so being in the posture within RAISE_MS of the
+ * first sample after a tap counts as a raise too.
+ */
+#define RAISE_SAMPLES		20      /* RAISE_MS at up to 25Hz */
+#define RAISE_MS		700
+#define RAISE_RISE_MG		400
+#define RAISE_DROP_MG		200
+#define RAISE_MIN_STEPS		2
+
+extern const Detector raise_detector;
+
+const Detector *detector_for_profile(uint8_t profile, uint8_t kind);
@@ -0,0 +1,64 @@
+#include <pebble_worker.h>
+#include "evlog.h"
+#include "../src/log.h"
+
+typedef struct {
+    uint32_t secs;
+    uint8_t code;
+    uint8_t arg;
+} EvlogEntry;
+
+static EvlogEntry ring[EVLOG_ENTRIES];
+static uint8_t next;                    /* slot for the next entry */
+static bool wrapped;
+static time_t start;
+
+
+void
+evlog_init (void)
+{
+    start = time(0L);
+    next = 0;
+    wrapped = false;
+}
+
+
+void
+evlog_add (uint16_t code, uint16_t arg)
+{
+    ring[next].code = (uint8_t)code;
+    ring[next].arg = (uint8_t)arg;
+    ring[next].secs = (uint32_t)(time(0L) - start);
+    if (++next == EVLOG_ENTRIES) {
+        next = 0;
+        wrapped = true;
+    }
+}
+
+
+/*
+ * Send the ring to the app, oldest first, one worker message per entry
+ * with data0 = code, data1 = arg | seconds >> 16 << 8, data2 = the low
+ * 16 bits of the seconds; EVLOG_END finishes.  24 bits of seconds last
+ * 194 days.
+ */
+void
+evlog_send (uint8_t type)
+{
+    AppWorkerMessage msg;
+    uint8_t i = wrapped ? next : 0;
+    uint8_t n = wrapped ? EVLOG_ENTRIES : next;
+
+    while (n--) {
+        msg.data0 = ring[i].code;
+        msg.data1 = ring[i].arg | (uint16_t)((ring[i].secs >> 16) << 8);
+        msg.data2 = (uint16_t)ring[i].secs;
+        app_worker_send_message(type, &msg);
+        i = (i + 1) % EVLOG_ENTRIES;
+    }
+
+    msg.data0 = EVLOG_END;
+    msg.data1 = 0;
+    msg.data2 = 0;
+    app_worker_send_message(type, &msg);
+}
@@ -0,0 +1,19 @@
+/*
+ * Binary event log for the worker.
+ *
+ * A small ring of (code, arg, seconds since start) entries, cheap enough
+ * to record on every state change.  Codes and args fit in a byte; the
+ * seconds don't wrap while the worker runs for days.  Nothing is
+ * formatted on the watch; the app asks for the ring with WORKER_DUMP_LOG
+ * and logs it by name.
+ * Codes are the EVLOG_* values in src/log.h.
+ */
+#pragma once
+
+#include <pebble_worker.h>
+
+#define EVLOG_ENTRIES	32
+
+void evlog_init(void);
+void evlog_add(uint16_t code, uint16_t arg);
+void evlog_send(uint8_t type);
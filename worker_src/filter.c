@@ -0,0 +1,126 @@
+#include <pebble_worker.h>
+#include "filter.h"
+
+#define LP_ONE		256     /* low-pass coefficient 1.0 */
+#define LP_FRAC		4       /* fraction bits of the low-pass state */
+
+static uint8_t median_taps = FILTER_MEDIAN;
+static uint16_t tau_ms = FILTER_TAU_MS;
+static uint32_t step = 100;             /* ms between samples */
+static uint16_t lp_a = LP_ONE;          /* per sample, in 1/LP_ONE */
+
+static bool primed;                     /* state holds a sample */
+static int16_t ring[3][FILTER_MEDIAN_5];
+static uint8_t ring_pos;
+static int32_t lp[3];                   /* mg << LP_FRAC */
+
+
+void
+filter_configure (uint8_t median, uint16_t tau)
+{
+
+    if (median != FILTER_MEDIAN_3 && median != FILTER_MEDIAN_5)
+        median = FILTER_MEDIAN_OFF;
+    median_taps = median;
+    tau_ms = tau;
+    filter_set_step(step);
+    filter_reset();
+}
+
+/*
+ * The time between samples changed with the sampling rate: keep the
+ * low-pass time constant, a = step / (tau + step)
+ */
+void
+filter_set_step (uint32_t step_ms)
+{
+
+    step = step_ms;
+    lp_a = LP_ONE;
+    if (tau_ms)
+        lp_a = (uint16_t)((LP_ONE * step_ms + (tau_ms + step_ms) / 2) /
+                          (tau_ms + step_ms));
+    if (lp_a == 0)
+        lp_a = 1;
+}
+
+/*
+ * Forget the past, when sampling restarts after a gap
+ */
+void
+filter_reset (void)
+{
+
+    primed = false;
+}
+
+
+static int16_t
+median3 (int16_t a, int16_t b, int16_t c)
+{
+
+    if (a > b) {
+        int16_t t = a;
+
+        a = b;
+        b = t;
+    }
+    /* a <= b */
+    if (c <= a)
+        return(a);
+    return(c < b ? c : b);
+}
+
+static int16_t
+median5 (const int16_t *v)
+{
+    int16_t s[FILTER_MEDIAN_5], t;
+    int i, j;
+
+    for (i = 0 ; i < FILTER_MEDIAN_5 ; i++) {
+        t = v[i];
+        for (j = i ; j > 0 && s[j - 1] > t ; j--)
+            s[j] = s[j - 1];
+        s[j] = t;
+    }
+    return(s[FILTER_MEDIAN_5 / 2]);
+}
+
+
+/*
+ * Filter one sample in place
+ */
+void
+filter_sample (AccelRawData *s)
+{
+    int16_t *v[3] = { &s->x, &s->y, &s->z };
+    int i, k;
+
+    if (!primed) {
+        for (i = 0 ; i < 3 ; i++) {
+            for (k = 0 ; k < FILTER_MEDIAN_5 ; k++)
+                ring[i][k] = *v[i];
+            lp[i] = (int32_t)*v[i] << LP_FRAC;
+        }
+        ring_pos = 0;
+        primed = true;
+        return;
+    }
+
+    if (median_taps != FILTER_MEDIAN_OFF) {
+        ring_pos = (ring_pos + 1) % median_taps;
+        for (i = 0 ; i < 3 ; i++) {
+            ring[i][ring_pos] = *v[i];
+            *v[i] = (median_taps == FILTER_MEDIAN_3) ?
+                median3(ring[i][0], ring[i][1], ring[i][2]) :
+                median5(ring[i]);
+        }
+    }
+
+    if (lp_a != LP_ONE) {
+        for (i = 0 ; i < 3 ; i++) {
+            lp[i] += ((((int32_t)*v[i] << LP_FRAC) - lp[i]) * lp_a) / LP_ONE;
+            *v[i] = (int16_t)((lp[i] + (1 << (LP_FRAC - 1))) >> LP_FRAC);
+        }
+    }
+}
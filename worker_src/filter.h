@@ -0,0 +1,34 @@
+/*
+ * Pre-filter for the samples the posture detectors see.
+ *
+ * A single jolt that lands outside the viewing posture while the light
+ * is on turns it off, and one that lands inside starts a raise, so the
+ * samples are cleaned up before they are classified.  Two stages, each
+ * optional, all state static:
+ *
+ *   median	per axis, over the last FILTER_MEDIAN_3 or FILTER_MEDIAN_5
+ *		samples; drops spikes shorter than half the window
+ *   low-pass	first order IIR in fixed point, y += (x - y) * a, with a
+ *		worked out from a time constant so that it behaves the same
+ *		at every sampling rate
+ *
+ * The median runs first so that a spike never reaches the low-pass.
+ * Each costs a few integer operations per axis per sample.  Settings are
+ * compiled in; tools/replay -F tries others against recorded traces.
+ */
+#pragma once
+
+#include <pebble_worker.h>
+
+#define FILTER_MEDIAN_OFF	1
+#define FILTER_MEDIAN_3		3
+#define FILTER_MEDIAN_5		5
+
+/* Best on the replay corpus; the low-pass costs latency for little gain */
+#define FILTER_MEDIAN		FILTER_MEDIAN_3
+#define FILTER_TAU_MS		0       /* low-pass time constant, 0 = off */
+
+void filter_configure(uint8_t median, uint16_t tau_ms);
+void filter_set_step(uint32_t step_ms);
+void filter_reset(void);
+void filter_sample(AccelRawData *s);
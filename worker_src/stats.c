@@ -0,0 +1,93 @@
+#include <pebble_worker.h>
+#include "stats.h"
+#include "../src/config.h"
+
+static uint32_t counter[STATS_COUNT];
+static time_t start;
+static uint8_t lit_reason;              /* 0 = off */
+static uint64_t lit_since;              /* ms */
+
+
+static uint64_t
+now_ms (void)
+{
+    time_t s;
+    uint16_t ms;
+
+    time_ms(&s, &ms);
+    return((uint64_t)s * 1000 + ms);
+}
+
+
+void
+stats_init (void)
+{
+
+    memset(counter, 0, sizeof(counter));
+    start = time(0L);
+    lit_reason = 0;
+}
+
+
+void
+stats_count (uint8_t c)
+{
+    counter[c]++;
+}
+
+
+/*
+ * A new reason takes over the light from the old one
+ */
+void
+stats_light_on (uint8_t reason)
+{
+
+    stats_light_off();
+    lit_reason = reason;
+    lit_since = now_ms();
+    if (reason == STATS_ON_RAISE)
+        counter[STATS_RAISES]++;
+}
+
+
+void
+stats_light_off (void)
+{
+    uint32_t ms;
+
+    if (!lit_reason)
+        return;
+
+    ms = (uint32_t)(now_ms() - lit_since);
+    counter[lit_reason] += ms;
+    if (lit_reason == STATS_ON_RAISE && ms < STATS_SHORT_MS)
+        counter[STATS_SHORT]++;
+    lit_reason = 0;
+}
+
+
+void
+stats_send (uint8_t type)
+{
+    AppWorkerMessage msg;
+    uint32_t v;
+    uint8_t i;
+
+    counter[STATS_UPTIME] = (uint32_t)(time(0L) - start);
+    for (i = 0 ; i < STATS_COUNT ; i++) {
+        v = counter[i];
+        /* include the time lit so far */
+        if (lit_reason && i == lit_reason)
+            v += (uint32_t)(now_ms() - lit_since);
+        msg.data0 = i;
+        msg.data1 = (uint16_t)v;
+        msg.data2 = (uint16_t)(v >> 16);
+        app_worker_send_message(type, &msg);
+    }
+
+    msg.data0 = STATS_END;
+    msg.data1 = 0;
+    msg.data2 = 0;
+    app_worker_send_message(type, &msg);
+}
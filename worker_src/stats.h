@@ -0,0 +1,20 @@
+/*
+ * Energy accounting for the worker.
+ *
+ * Counts what the backlight costs since the worker started: light-on
+ * time by reason, accel batches handled, raises, and raises whose light
+ * went off again within STATS_SHORT_MS, which were most likely false.
+ * The counters are the STATS_* values in src/config.h and are sent to
+ * the app on request with WORKER_STATS.
+ */
+#pragma once
+
+#include <pebble_worker.h>
+
+#define STATS_SHORT_MS	1000
+
+void stats_init(void);
+void stats_count(uint8_t counter);
+void stats_light_on(uint8_t reason);    /* STATS_ON_* */
+void stats_light_off(void);
+void stats_send(uint8_t type);
@@ -0,0 +1,272 @@
+#include <pebble_worker.h>
+#include "trace.h"
+#include "../src/log.h"
+
+#define TAG_MEDIUM	0x80
+#define TAG_FULL	0xA0
+#define TAG_EVENT	0xC0
+#define TAG_SYNC	0xE0
+#define TAG_END		0xFF
+
+static uint8_t *ring = NULL;            /* TRACE_BLOCKS * TRACE_BLOCK_SIZE */
+static uint8_t head;                    /* oldest block */
+static uint8_t count;                   /* blocks in use */
+static uint8_t cur;                     /* block being written */
+static uint8_t pos;                     /* write offset in cur */
+static bool need_key;                   /* next sample opens a block */
+
+static uint8_t rate;
+static time_t base_time;
+static uint64_t base_ms;
+static uint64_t next_ts;                /* where decoder will put next sample */
+static int16_t last_x, last_y, last_z;
+
+
+bool
+trace_active (void)
+{
+    return(ring != NULL);
+}
+
+
+static void
+new_block (void)
+{
+    if (count == 0) {
+        cur = head;
+        count = 1;
+    } else {
+        cur = (cur + 1) % TRACE_BLOCKS;
+        if (count == TRACE_BLOCKS) {
+            head = (head + 1) % TRACE_BLOCKS; /* drop the oldest */
+        } else {
+            count++;
+        }
+    }
+    memset(&ring[cur * TRACE_BLOCK_SIZE], TAG_END, TRACE_BLOCK_SIZE);
+    pos = 0;
+    need_key = true;
+}
+
+
+bool
+trace_start (uint8_t rate_hz)
+{
+    if (ring)
+        return(true);
+
+    ring = malloc(TRACE_BLOCKS * TRACE_BLOCK_SIZE);
+    if (!ring) {
+        LOG(APP_LOG_LEVEL_ERROR, "No memory for trace");
+        return(false);
+    }
+    rate = rate_hz;
+    base_time = time(0L);
+    base_ms = (uint64_t)base_time * 1000;
+    head = 0;
+    count = 0;
+    new_block();
+    return(true);
+}
+
+
+void
+trace_stop (void)
+{
+    free(ring);
+    ring = NULL;
+}
+
+
+static inline void
+put8 (uint8_t v)
+{
+    ring[cur * TRACE_BLOCK_SIZE + pos++] = v;
+}
+
+static inline void
+put16 (int16_t v)
+{
+    put8((uint8_t)v);
+    put8((uint8_t)((uint16_t)v >> 8));
+}
+
+static inline bool
+fits (int v, int lim)
+{
+    return(v >= -lim && v < lim);
+}
+
+
+static void
+record_sample (const AccelData *s)
+{
+    uint32_t period = 1000 / rate;
+    int dx, dy, dz;
+    int64_t skew;
+    bool sync;
+    uint8_t len;
+
+    for (;;) {
+        dx = s->x - last_x;
+        dy = s->y - last_y;
+        dz = s->z - last_z;
+        skew = (int64_t)(s->timestamp - next_ts);
+        sync = need_key || skew > (int64_t)period / 2 ||
+            skew < -(int64_t)period / 2;
+
+        if (need_key) {
+            len = 7;
+        } else if (!s->did_vibrate &&
+                   fits(dx, 16) && fits(dy, 16) && fits(dz, 16)) {
+            len = 2;
+        } else if (fits(dx, 128) && fits(dy, 128) && fits(dz, 128)) {
+            len = 4;
+        } else {
+            len = 7;
+        }
+        if (sync)
+            len += 5;
+        if (pos + len <= TRACE_BLOCK_SIZE)
+            break;
+        new_block();
+    }
+
+    if (sync) {
+        uint32_t t = (uint32_t)(s->timestamp - base_ms);
+
+        put8(TAG_SYNC);
+        put8((uint8_t)t);
+        put8((uint8_t)(t >> 8));
+        put8((uint8_t)(t >> 16));
+        put8((uint8_t)(t >> 24));
+        next_ts = s->timestamp;
+        len -= 5;
+    }
+
+    if (len == 2) {
+        uint16_t v = ((dx & 0x1f) << 10) | ((dy & 0x1f) << 5) | (dz & 0x1f);
+
+        put8((uint8_t)(v >> 8));
+        put8((uint8_t)v);
+    } else if (len == 4) {
+        put8(TAG_MEDIUM | s->did_vibrate);
+        put8((uint8_t)dx);
+        put8((uint8_t)dy);
+        put8((uint8_t)dz);
+    } else {
+        put8(TAG_FULL | s->did_vibrate);
+        put16(s->x);
+        put16(s->y);
+        put16(s->z);
+    }
+
+    need_key = false;
+    next_ts += period;
+    last_x = s->x;
+    last_y = s->y;
+    last_z = s->z;
+}
+
+
+void
+trace_record (AccelData *data, uint32_t num_samples)
+{
+    uint32_t i;
+
+    if (!ring)
+        return;
+
+    for (i = 0 ; i < num_samples ; i++) {
+        record_sample(&data[i]);
+    }
+}
+
+
+/*
+ * Events belong to the last sample written, or to the following sync
+ * when they open a block.
+ */
+void
+trace_event (uint8_t event)
+{
+    if (!ring)
+        return;
+
+    if (pos + 1 > TRACE_BLOCK_SIZE)
+        new_block();
+    put8(TAG_EVENT | (event & 0x1f));
+}
+
+
+void
+trace_export (TraceEmitter emit, void *context)
+{
+    uint8_t hdr[TRACE_HEADER_SIZE];
+    uint32_t t = (uint32_t)base_time;
+    uint8_t i;
+
+    if (!ring)
+        return;
+
+    memcpy(hdr, "BLTR", 4);
+    hdr[4] = TRACE_VERSION;
+    hdr[5] = rate;
+    hdr[6] = (uint8_t)TRACE_BLOCK_SIZE;
+    hdr[7] = (uint8_t)(TRACE_BLOCK_SIZE >> 8);
+    hdr[8] = count;
+    hdr[9] = 0;
+    hdr[10] = 0;
+    hdr[11] = 0;
+    hdr[12] = (uint8_t)t;
+    hdr[13] = (uint8_t)(t >> 8);
+    hdr[14] = (uint8_t)(t >> 16);
+    hdr[15] = (uint8_t)(t >> 24);
+    emit(hdr, sizeof(hdr), context);
+
+    for (i = 0 ; i < count ; i++) {
+        emit(&ring[((head + i) % TRACE_BLOCKS) * TRACE_BLOCK_SIZE],
+             TRACE_BLOCK_SIZE, context);
+    }
+}
+
+
+/*
+ * Dump the trace as hex through the log, 16 bytes a line, each line
+ * prefixed with its file offset so lost lines can be spotted:
+ *
+ *	TRC 0040 0123456789abcdef...
+ *
+ * tools/replay reads a captured log containing these lines directly.
+ */
+#define DUMP_LINE	16
+
+static void
+dump_emit (const uint8_t *data, size_t len, void *context)
+{
+    static const char hex[] = "0123456789abcdef";
+    uint32_t *offset = context;
+    char line[DUMP_LINE * 2 + 1];
+    size_t i, n;
+
+    while (len) {
+        n = len < DUMP_LINE ? len : DUMP_LINE;
+        for (i = 0 ; i < n ; i++) {
+            line[i * 2] = hex[data[i] >> 4];
+            line[i * 2 + 1] = hex[data[i] & 0xf];
+        }
+        line[n * 2] = '\0';
+        APP_LOG(APP_LOG_LEVEL_INFO, "TRC %04x %s", (uint)*offset, line);
+        *offset += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void
+trace_dump_log (void)
+{
+    uint32_t offset = 0;
+
+    trace_export(dump_emit, &offset);
+}
@@ -0,0 +1,54 @@
+/*
+ * Accelerometer trace recorder for the backlight worker.
+ *
+ * Samples are delta-encoded into a fixed ring of blocks.  Each block
+ * starts with a time sync and a full sample, so the oldest block can be
+ * dropped whole when the ring wraps and every block decodes on its own.
+ *
+ * Exported file layout (all integers little-endian):
+ *
+ *	offset	size	field
+ *	0	4	magic "BLTR"
+ *	4	1	version (TRACE_VERSION)
+ *	5	1	sampling rate in Hz
+ *	6	2	block size in bytes
+ *	8	2	number of blocks that follow, oldest first
+ *	10	2	reserved, 0
+ *	12	4	base time, seconds since the epoch
+ *	16	...	blocks
+ *
+ * Records inside a block, by first byte:
+ *
+ *	0xxxxxxx xxxxxxxx	compact sample: dx, dy, dz as 5-bit signed
+ *				fields, most significant first (2 bytes)
+ *	1000000v dx dy dz	medium sample: int8 deltas, v = did_vibrate
+ *	1010000v x x y y z z	full sample: int16 absolute values
+ *	110eeeee		event e (TRACE_EVENT_*), at the last sample
+ *	11100000 t t t t	sync: uint32 ms since base time of next sample
+ *	11111111		end of block, rest of block is padding
+ *
+ * Samples following a sync are spaced 1000 / rate ms apart.
+ */
+#pragma once
+
+#include <pebble_worker.h>
+
+#define TRACE_VERSION		1
+#define TRACE_BLOCK_SIZE	64
+#define TRACE_BLOCKS		24      /* 1.5k: 35-75s at 10Hz */
+#define TRACE_HEADER_SIZE	16
+
+#define TRACE_EVENT_LIGHT_ON		1
+#define TRACE_EVENT_LIGHT_OFF		2
+#define TRACE_EVENT_CHARGING_ON		3
+#define TRACE_EVENT_PLUGGED_ON		4
+
+typedef void (*TraceEmitter)(const uint8_t *data, size_t len, void *context);
+
+bool trace_start(uint8_t rate_hz);
+void trace_stop(void);
+bool trace_active(void);
+void trace_record(AccelData *data, uint32_t num_samples);
+void trace_event(uint8_t event);
+void trace_export(TraceEmitter emit, void *context);
+void trace_dump_log(void);
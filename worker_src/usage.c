@@ -0,0 +1,155 @@
+#include <pebble_worker.h>
+#include "usage.h"
+#include "../src/log.h"
+
+static DataLoggingSessionRef session = NULL;
+static UsageRecord batch[USAGE_BATCH];
+static uint8_t count;                   /* records waiting in batch */
+static uint8_t lit_reason;              /* 0 = off */
+static uint64_t lit_since;              /* ms */
+static AppTimer *flush_timer = NULL;    /* the oldest record's wait is up */
+
+
+static uint64_t
+now_ms (void)
+{
+    time_t s;
+    uint16_t ms;
+
+    time_ms(&s, &ms);
+    return((uint64_t)s * 1000 + ms);
+}
+
+
+bool
+usage_start (void)
+{
+    if (session)
+        return(true);
+
+    /* resume: one session across worker restarts */
+    session = data_logging_create(USAGE_TAG, DATA_LOGGING_BYTE_ARRAY,
+                                  sizeof(UsageRecord), true);
+    if (!session) {
+        LOG(APP_LOG_LEVEL_ERROR, "No data logging session");
+        return(false);
+    }
+    count = 0;
+    return(true);
+}
+
+
+void
+usage_stop (void)
+{
+    if (!session)
+        return;
+
+    usage_flush();
+    data_logging_finish(session);
+    session = NULL;
+}
+
+
+static void usage_flush_timer(void *data);
+
+static void
+arm_flush (void)
+{
+
+    if (!flush_timer)
+        flush_timer = app_timer_register(USAGE_FLUSH_SECS * 1000,
+                                         usage_flush_timer, NULL);
+}
+
+/*
+ * Hand the batch to the system.  If it is busy the batch is kept for the
+ * next try; if storage is full the records are dropped.
+ */
+void
+usage_flush (void)
+{
+    DataLoggingResult r;
+
+    if (flush_timer) {
+        app_timer_cancel(flush_timer);
+        flush_timer = NULL;
+    }
+    if (!session || count == 0)
+        return;
+
+    r = data_logging_log(session, batch, count);
+    if (r == DATA_LOGGING_BUSY && count < USAGE_BATCH) {
+        arm_flush();
+        return;
+    }
+    if (r != DATA_LOGGING_SUCCESS)
+        LOG(APP_LOG_LEVEL_WARNING, "usage log dropped %u: %d", (uint)count, (int)r);
+    count = 0;
+}
+
+static void
+usage_flush_timer (void *data)
+{
+
+    flush_timer = NULL;
+    usage_flush();
+}
+
+
+static void
+usage_add (uint8_t event, uint8_t reason, uint16_t dwell, uint16_t lit)
+{
+    BatteryChargeState charge = battery_state_service_peek();
+    UsageRecord *rec;
+    time_t now = time(0L);
+
+    if (count == USAGE_BATCH)
+        usage_flush();                  /* still busy: make room */
+    if (count == USAGE_BATCH)
+        count = 0;
+
+    rec = &batch[count++];
+    rec->time = (uint32_t)now;
+    rec->event = event;
+    rec->reason = reason;
+    rec->battery = charge.charge_percent;
+    rec->flags = (charge.is_charging ? USAGE_CHARGING : 0) |
+        (charge.is_plugged ? USAGE_PLUGGED : 0);
+    rec->dwell = dwell;
+    rec->lit = lit;
+
+    if (count == USAGE_BATCH)
+        usage_flush();
+    else
+        arm_flush();                    /* for the first of a batch */
+}
+
+
+void
+usage_light_on (uint8_t reason, uint32_t dwell_ms)
+{
+
+    usage_light_off();
+    lit_reason = reason;
+    lit_since = now_ms();
+    if (session)
+        usage_add(USAGE_LIGHT_ON, reason,
+                  dwell_ms > 0xffff ? 0xffff : (uint16_t)dwell_ms, 0);
+}
+
+
+void
+usage_light_off (void)
+{
+    uint64_t tenths;
+
+    if (!lit_reason)
+        return;
+
+    tenths = (now_ms() - lit_since) / 100;
+    if (session)
+        usage_add(USAGE_LIGHT_OFF, lit_reason, 0,
+                  tenths > 0xffff ? 0xffff : (uint16_t)tenths);
+    lit_reason = 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * Long-term usage log for the worker.
+ *
+ * Every light on and off becomes a fixed-size record, kept in a small
+ * batch in RAM and handed to the data logging service USAGE_BATCH at a
+ * time, or sooner once the oldest has waited USAGE_FLUSH_SECS: a timer
+ * armed with the first record of a batch sees to that even when nothing
+ * else happens.  The system stores the records and sends them to the
+ * phone when it can; nothing is formatted on the watch.  tools/usage2csv
+ * decodes them.
+ *
+ * Record layout, session tag USAGE_TAG, all integers little-endian.  The
+ * records carry no version: a different layout gets a new tag.
+ *
+ *	offset	size	field
+ *	0	4	time, seconds since the epoch (UTC)
+ *	4	1	event: USAGE_LIGHT_ON or USAGE_LIGHT_OFF
+ *	5	1	what lit the light: STATS_ON_* in src/config.h
+ *	6	1	battery charge percent
+ *	7	1	USAGE_CHARGING | USAGE_PLUGGED
+ *	8	2	on: raise held before lighting, ms
+ *	10	2	off: time lit, 1/10 s, saturating
+ */
+#pragma once
+
+#include <pebble_worker.h>
+
+#define USAGE_TAG		0x424c5553      /* "BLUS" */
+#define USAGE_RECORD_SIZE	12
+#define USAGE_BATCH		16
+#define USAGE_FLUSH_SECS	(15 * 60)
+
+#define USAGE_LIGHT_ON		1
+#define USAGE_LIGHT_OFF		2
+
+#define USAGE_CHARGING		0x01
+#define USAGE_PLUGGED		0x02
+
+typedef struct __attribute__((__packed__)) {
+    uint32_t time;
+    uint8_t event;
+    uint8_t reason;
+    uint8_t battery;
+    uint8_t flags;
+    uint16_t dwell;
+    uint16_t lit;
+} UsageRecord;
+
+bool usage_start(void);
+void usage_stop(void);
+void usage_flush(void);
+void usage_light_on(uint8_t reason, uint32_t dwell_ms);
+void usage_light_off(void);